@@ -0,0 +1,45 @@
+#!/bin/sh
+#
+# Runs the BFS version with chunks on the given inputs with different
+# chunk lengths and prints the execution time (seconds) of each run.
+#
+#   bench/chunk_length.sh [-H] input1 [input2 ...]
+#
+# Set LENGTHS to change the chunk lengths tried and CC/CFLAGS to change
+# the build. With -H the chunk pool is backed by huge pages.
+
+LENGTHS=${LENGTHS:-"64 128 256 512 1024 2048 4096 16384"}
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:-"-O2"}
+
+HUGE=""
+if [ "$1" = "-H" ]; then
+	HUGE="-H"
+	shift
+fi
+if [ $# -eq 0 ]; then
+	echo "usage: $0 [-H] input1 [input2 ...]" >&2
+	exit 1
+fi
+
+DIR=$(dirname "$0")
+BIN=$(mktemp /tmp/ndtm_bench.XXXXXX)
+trap 'rm -f "$BIN"' EXIT
+$CC $CFLAGS -o "$BIN" "$DIR/../src/ndtm_STATIC_QUEUE_iterative.c" "$DIR/../src/libndtm.c" -lpthread || exit 1
+
+printf "%-40s" "input"
+for k in $LENGTHS; do
+	printf "%10s" "$k"
+done
+printf "\n"
+
+for input in "$@"; do
+	printf "%-40s" "$(basename "$(dirname "$input")")/$(basename "$input")"
+	for k in $LENGTHS; do
+		start=$(date +%s.%N)
+		"$BIN" $HUGE -k "$k" < "$input" > /dev/null
+		end=$(date +%s.%N)
+		awk -v s="$start" -v e="$end" 'BEGIN { printf "%10.3f", e - s }'
+	done
+	printf "\n"
+done
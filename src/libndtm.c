@@ -0,0 +1,1435 @@
+//
+//  libndtm.c
+//  ndtm
+//
+//  The BFS algorithm with chunked tapes, with the state of each
+//  computation kept in a run instead of global variables.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "libndtm.h"
+
+#define BLANK 			        '_'
+#define RIGHT                    1
+#define LEFT  			        -1
+#define STOP  			         0
+#define DEFAULT_STATES_DIM     256
+#define STATES_GROWTH			 2		// the graph grows geometrically
+#define POSSIBLE_CHARS_NUM	   127
+#define MIN_CHAR				 0
+#define DEFAULT_LEVEL_DIM	   512		// initial number of configurations of a level (levels grow as needed)
+#define PREFETCH_DISTANCE		 8		// configurations between a prefetch and their use
+#ifndef TAPE_CHUNK_LENGTH
+#define TAPE_CHUNK_LENGTH	   512		// default number of cells of a chunk
+#endif
+#define CACHE_LINE_DIM			64		// chunks are aligned to cache lines
+#define POOL_SLAB_DIM	   (2 << 20)	// memory requested to the system at once for the chunks (a huge page)
+#define DEFAULT_DIRECTORY_DIM	 4		// initial number of slots of the chunk directory of a tape
+#define POOLED_DIRECTORY_DIM  1024		// larger directories are freed when their tape goes back to the pool
+#define DEFAULT_INPUT_CHUNKS	16		// initial number of chunks of a streamed string
+#define BUDGET_CHECK_PERIOD	  1024		// steps between two checks of the time budget (and of the checkpoint period)
+#define CHECKPOINT_MAGIC	"NDTMCKP2"	// first bytes of a checkpoint file
+#define CHECKPOINT_BUFFER_DIM (1 << 16)	// bytes written at once to a checkpoint file
+#define FNV_OFFSET	14695981039346656037UL
+#define FNV_PRIME		1099511628211UL
+
+typedef enum {true, false} bool;
+
+typedef struct graph_node {       // node of the graph
+	char in;
+	char out;
+	int move;
+	int next_state;
+	struct graph_node * next;     // list of all possible next states of the current one
+} graph_node;
+
+typedef struct state {
+	graph_node ** transitions;
+	bool isAccState;
+} state;
+
+typedef struct tape_chunk {      // header and cells of a chunk are a single block of the pool
+    struct tape_chunk * next;     // next free chunk, while the chunk is in the pool
+    char string[];                // the chunkLength cells of the chunk
+} tape_chunk;
+
+typedef struct tm_tape {
+	tape_chunk ** chunks;         // directory of the chunks: chunk number n (0 is the first of the input) is chunks[origin+n]
+	int origin;
+	int first;                    // the slots from first to last (excluded) hold the chunks of the tape
+	int last;
+	int dim;
+	int low;                      // the cells from low to high (0 is the first of the input) are the only ones
+	int high;                     // written or visited: the others are BLANK, even if their chunk holds garbage
+	int pointers_num;             // only the thread using the run touches its tapes, so no atomics
+	struct tm_tape * next;        // next free tape, while the tape is in the pool (with its directory)
+} tm_tape;
+
+typedef struct checkpoint_header {   // first bytes of a checkpoint file, followed by the configurations
+	char magic[8];
+	unsigned long fingerprint;    // hash of the machine the checkpoint belongs to
+	unsigned long stringHash;     // hash of the cells of the string, as given to the run
+	long int label;               // chosen by the caller (the simulator stores the string number)
+	long int currIteration;       // the level saved (no configuration of it has been computed yet)
+	long int stepsNum;
+	long int elapsed;             // milliseconds of computation before the checkpoint
+	int chunkLength;
+	int configurationsNum;
+	bool atLeastAnUndefinedPath;
+} checkpoint_header;
+
+typedef struct checkpoint_writer {   // buffered writes of the process saving a checkpoint (no malloc after fork)
+	int fd;
+	size_t used;
+	bool failed;
+	char buffer[CHECKPOINT_BUFFER_DIM];
+} checkpoint_writer;
+
+typedef struct level {            // the configurations of a BFS level, as parallel arrays
+	int * states;
+	graph_node ** transitions;    // the transition each configuration is going to follow
+	int * chunks;                 // number of the chunk of the head
+	int * indexes;                // position of the head inside its chunk
+	tm_tape ** tapes;
+	int num;
+	int dim;
+} level;
+
+typedef struct state_slot {      // an id given by the user in the map of the states
+	long int id;
+	int index;                    // where the state is in the graph, -1 if the slot is empty
+} state_slot;
+
+struct ndtm_machine {
+	state * graph;                // the states, numbered densely in order of appearance
+	int states_num;               // the number of states of the TM
+	int states_dim;               // the actual size of the graph array
+	state_slot * stateSlots;      // map from the ids to the indexes of the graph
+	int stateSlotsDim;
+	long int iterationsLimit;     // the limit to the iteration number (to avoid machine loop)
+};
+
+struct ndtm_run {
+	const ndtm_machine * machine;
+	bool * canAccept;             // true if an acceptation state is reachable from the state
+
+	level levels[2];              // the level being computed and the next one
+	level * currLevel;
+	level * nextLevel;
+	int levelHead;                // the configurations of currLevel before levelHead have been computed
+
+	tm_tape * tape;               // the tape of the next string
+	int tapeFill;                 // the cells of the last chunk of tape filled so far
+
+	long int currIteration;
+	bool acceptString;            // true when a path accepts the input string
+	bool atLeastAnUndefinedPath;  // true when at least a path returns UNDEFINED (iteration > iterationsLimit)
+
+	long int stepsBudget;         // maximum number of steps (over all the paths) for each string, 0 if unlimited
+	long int timeBudget;          // maximum execution time (milliseconds) for each string, 0 if unlimited
+	long int stepsNum;            // the number of steps performed on the current string
+	struct timespec startTime;    // when the computation of the current string started
+	int budgetExceeded;           // which budget, if any, stopped the current computation
+
+	int chunkLength;              // the number of cells of each chunk
+	size_t chunkBlockDim;         // the size of a chunk with its header, rounded up to cache lines
+	tape_chunk * freeChunks;      // chunks released to the pool
+	tm_tape * freeTapes;          // tapes released to the pool
+	char * poolNext;              // the part of the last slab never used yet
+	char * poolEnd;
+	bool hugePages;               // true to back the pool with huge pages
+	void ** slabs;                // the memory of the pool, given back when the run is freed
+	size_t * slabDims;
+	int slabsNum;
+	int slabsDim;
+
+	ndtm_reader reader;           // reads the string being streamed (NULL if not streaming)
+	void * readerData;
+	char ** inputChunks;          // the chunks of the streamed string read so far
+	int inputChunksNum;
+	int inputChunksDim;
+	bool inputEnded;              // true when the whole streamed string has been read
+
+	char * checkpointPath;        // where the search state is saved (NULL if not saved)
+	char * checkpointTemp;        // written first, then renamed, so the checkpoint is never partial
+	long int checkpointPeriod;    // milliseconds between two checkpoints
+	long int checkpointLabel;
+	long int checkpointCheck;     // the steps at which the checkpoint period is checked again
+	struct timespec checkpointTime;  // when the last checkpoint was started
+	pid_t checkpointWriter;       // the process saving a checkpoint, 0 if none
+	unsigned long fingerprint;    // hash of the machine
+	unsigned long stringHash;     // hash of the current string
+	bool resumePending;           // true when a checkpoint has been loaded and not resumed yet
+	checkpoint_header resumed;    // the counters of the loaded checkpoint
+};
+
+static int stateIndex(ndtm_machine *, long int);
+static void computeAcceptingStates(ndtm_run *);
+static void initLevel(level *);
+static void freeLevel(level *);
+static inline void putInLevel(level *, int, graph_node *, tm_tape *, int, int);
+static inline void releaseTape(ndtm_run *, tm_tape *);
+static void executeTM(ndtm_run *);
+static void startTM(ndtm_run *);
+static void executeLevels(ndtm_run *);
+static unsigned long hashMachine(const ndtm_machine *);
+static unsigned long hashTape(ndtm_run *, tm_tape *);
+static unsigned long hashBytes(unsigned long, const void *, size_t);
+static void checkpoint(ndtm_run *);
+static void writeCheckpoint(ndtm_run *);
+static void putBytes(checkpoint_writer *, const void *, size_t);
+static void flushBytes(checkpoint_writer *);
+static void endCheckpoints(ndtm_run *);
+static void freeQueue(ndtm_run *);
+static inline bool checkBudget(ndtm_run *);
+static tm_tape * newTape(ndtm_run *);
+static tm_tape * takeTape(ndtm_run *, int);
+static void * resizeArray(void *, size_t);
+static tape_chunk * appendTapeChunk(ndtm_run *, tm_tape *);
+static void updateIndex(ndtm_run *, tm_tape *, int *, int *);
+static inline void visitCell(tm_tape *, char *, int, int);
+static void windowOfChunk(ndtm_run *, tm_tape *, int, int *, int *);
+static void prependNewTapeChunk(ndtm_run *, tm_tape *);
+static void appendNewTapeChunk(ndtm_run *, tm_tape *);
+static tm_tape * copyTape(ndtm_run *, tm_tape *);
+static void freeTape(ndtm_run *, tm_tape *);
+static tape_chunk * allocChunk(ndtm_run *);
+static void releaseChunk(ndtm_run *, tape_chunk *);
+static bool readInputChunk(ndtm_run *);
+static char * getInputChunk(ndtm_run *, int);
+
+/*****************************************************************
+ * Returns a machine without states
+ *****************************************************************/
+ndtm_machine * ndtm_machine_new(long int maxSteps) {
+	ndtm_machine * m = (ndtm_machine *) malloc(sizeof(ndtm_machine));
+	m->states_num = 0;
+	m->states_dim = DEFAULT_STATES_DIM;
+	m->iterationsLimit = maxSteps;
+	m->graph = (state *) malloc(m->states_dim * sizeof(state));
+	for (int i = 0; i < m->states_dim; i++) {
+		m->graph[i].transitions = NULL;
+		m->graph[i].isAccState = false;
+	}
+	m->stateSlots = NULL;
+	m->stateSlotsDim = 0;
+	stateIndex(m, 0);		// the starting state is always the first one
+	return m;
+}
+
+/*****************************************************************
+ * Returns the index in the graph of the state with the given id,
+ * making room for the state if it is new: the memory depends on
+ * the number of states, not on their ids
+ *****************************************************************/
+static int stateIndex(ndtm_machine * m, long int id) {
+	if (2 * (m->states_num + 1) > m->stateSlotsDim) {		// keep the map at most half full
+		int oldDim = m->stateSlotsDim;
+		state_slot * old = m->stateSlots;
+		m->stateSlotsDim = (oldDim == 0) ? 2 * DEFAULT_STATES_DIM : 2 * oldDim;
+		m->stateSlots = (state_slot *) malloc(m->stateSlotsDim * sizeof(state_slot));
+		for (int i = 0; i < m->stateSlotsDim; i++)
+			m->stateSlots[i].index = -1;
+		for (int i = 0; i < oldDim; i++) {
+			if (old[i].index == -1)
+				continue;
+			unsigned long h = hashBytes(FNV_OFFSET, &old[i].id, sizeof(long int)) & (m->stateSlotsDim - 1);
+			while (m->stateSlots[h].index != -1)
+				h = (h + 1) & (m->stateSlotsDim - 1);
+			m->stateSlots[h] = old[i];
+		}
+		free(old);
+	}
+
+	unsigned long h = hashBytes(FNV_OFFSET, &id, sizeof(long int)) & (m->stateSlotsDim - 1);
+	while (m->stateSlots[h].index != -1) {
+		if (m->stateSlots[h].id == id)
+			return m->stateSlots[h].index;
+		h = (h + 1) & (m->stateSlotsDim - 1);
+	}
+
+	if (m->states_num == m->states_dim) {
+		int newDim = m->states_dim * STATES_GROWTH;
+		m->graph = (state *) realloc(m->graph, newDim * sizeof(state));
+		// initialize the new positions of the states vector (graph)
+		for (int i = m->states_dim; i < newDim; i++) {
+			m->graph[i].transitions = NULL;
+			m->graph[i].isAccState = false;
+		}
+		m->states_dim = newDim;
+	}
+	m->stateSlots[h].id = id;
+	m->stateSlots[h].index = m->states_num;
+	return m->states_num++;
+}
+
+/******************************************************************
+ * Inserts a transition in the graph
+ ******************************************************************/
+int ndtm_machine_add_transition(ndtm_machine * m, long int id, char in, char out, char move, long int nextId) {
+	int moveStep;
+	switch (move) {
+		case 'R': moveStep = RIGHT;
+				  break;
+		case 'L': moveStep = LEFT;
+				  break;
+		case 'S': moveStep = STOP;
+				  break;
+		default:  return -1;
+	}
+	if (in < MIN_CHAR || in - MIN_CHAR >= POSSIBLE_CHARS_NUM)
+		return -1;
+	int s = stateIndex(m, id);
+	int n_s = stateIndex(m, nextId);
+
+	graph_node * new = (graph_node *) malloc(sizeof(graph_node));
+	new->in = in;
+	new->out = out;
+	new->move = moveStep;
+	new->next_state = n_s;
+
+	if (m->graph[s].transitions == NULL) {   // first transition of the state
+		m->graph[s].transitions = (graph_node **) malloc(POSSIBLE_CHARS_NUM * sizeof(graph_node *));
+		for (int i = 0; i < POSSIBLE_CHARS_NUM; i++)
+			m->graph[s].transitions[i] = NULL;
+	}
+	new->next = m->graph[s].transitions[in-MIN_CHAR];
+	m->graph[s].transitions[in-MIN_CHAR] = new;
+	return 0;
+}
+
+/******************************************************************
+ * Marks an acceptation state
+ ******************************************************************/
+int ndtm_machine_add_accepting(ndtm_machine * m, long int id) {
+	m->graph[stateIndex(m, id)].isAccState = true;
+	return 0;
+}
+
+/*******************************************************************
+ * Reads the machine from the given file: transitions after "tr",
+ * acceptation states after "acc", the maximum number of steps after
+ * "max", up to the word "run" and the end of its line
+ *******************************************************************/
+ndtm_machine * ndtm_machine_read(FILE * f) {
+	long int s = -1;
+	long int next_s = -1;
+	char in[32], out[32], move[32];
+	char word[32];
+
+	if (fscanf(f, "%31s", word) != 1 || strcmp(word, "tr") != 0)
+		return NULL;
+
+	ndtm_machine * m = ndtm_machine_new(0);
+	if (fscanf(f, "%31s", word) != 1)
+		goto malformed;
+	while (strcmp(word, "acc") != 0) { 	// cycle until find the word "acc"
+		if (sscanf(word, "%ld", &s) != 1 || fscanf(f, "%31s %31s %31s %ld", in, out, move, &next_s) != 4)
+			goto malformed;
+		if (ndtm_machine_add_transition(m, s, in[0], out[0], move[0], next_s) != 0)
+			goto malformed;
+		if (fscanf(f, "%31s", word) != 1)
+			goto malformed;
+	}
+
+	if (fscanf(f, "%31s", word) != 1)
+		goto malformed;
+	while (strcmp(word, "max") != 0) { 	// read acceptation states
+		if (sscanf(word, "%ld", &s) != 1 || ndtm_machine_add_accepting(m, s) != 0)
+			goto malformed;
+		if (fscanf(f, "%31s", word) != 1)
+			goto malformed;
+	}
+
+	if (fscanf(f, "%ld", &m->iterationsLimit) != 1)    // read maximum number of iterations
+		goto malformed;
+
+	if (fscanf(f, "%31s", word) != 1 || strcmp(word, "run") != 0)
+		goto malformed;
+	fgetc(f); // consume '\n' character after "run" string
+	return m;
+
+malformed:
+	ndtm_machine_free(m);
+	return NULL;
+}
+
+//****************************************************************
+void ndtm_machine_free(ndtm_machine * m) {
+	for (int i = 0; i < m->states_dim; i++) {
+		if (m->graph[i].transitions == NULL)
+			continue;
+		for (int j = 0; j < POSSIBLE_CHARS_NUM; j++) {
+			graph_node * p = m->graph[i].transitions[j];
+			while (p != NULL) {
+				graph_node * next = p->next;
+				free(p);
+				p = next;
+			}
+		}
+		free(m->graph[i].transitions);
+	}
+	free(m->graph);
+	free(m->stateSlots);
+	free(m);
+}
+
+/*****************************************************************
+ * Returns a run of the given machine, with its own levels and
+ * chunk pool
+ *****************************************************************/
+ndtm_run * ndtm_run_new(const ndtm_machine * m, int chunkLength, int hugePages) {
+	if (chunkLength < 0)
+		return NULL;
+
+	ndtm_run * r = (ndtm_run *) calloc(1, sizeof(ndtm_run));
+	r->machine = m;
+	r->chunkLength = (chunkLength == 0) ? TAPE_CHUNK_LENGTH : chunkLength;
+	r->chunkBlockDim = (sizeof(tape_chunk) + r->chunkLength + CACHE_LINE_DIM - 1) / CACHE_LINE_DIM * CACHE_LINE_DIM;
+	r->hugePages = (hugePages != 0) ? true : false;
+	r->acceptString = false;
+	r->atLeastAnUndefinedPath = false;
+	r->budgetExceeded = NDTM_BUDGET_NONE;
+	r->inputEnded = true;
+
+	r->currLevel = &r->levels[0];
+	r->nextLevel = &r->levels[1];
+	initLevel(r->currLevel);
+	initLevel(r->nextLevel);
+
+	r->tape = newTape(r);
+	r->tapeFill = r->chunkLength;		// no chunk to be filled yet
+
+	computeAcceptingStates(r);
+	return r;
+}
+
+/*****************************************************************
+ * Sets the budgets of the following strings
+ *****************************************************************/
+void ndtm_run_set_budget(ndtm_run * r, long int steps, long int time) {
+	r->stepsBudget = steps;
+	r->timeBudget = time;
+}
+
+/*****************************************************************
+ * Runs the machine on the given string
+ *****************************************************************/
+char ndtm_run_string(ndtm_run * r, const char * string, size_t length) {
+	ndtm_run_append(r, string, length);
+	return ndtm_run_execute(r);
+}
+
+/*****************************************************************
+ * Copies cells at the end of the tape of the next string, adding
+ * chunks as needed
+ *****************************************************************/
+void ndtm_run_append(ndtm_run * r, const char * cells, size_t n) {
+	while (n > 0) {
+		if (r->tapeFill == r->chunkLength) {
+			appendTapeChunk(r, r->tape);
+			r->tapeFill = 0;
+		}
+		size_t k = r->chunkLength - r->tapeFill;
+		if (k > n)
+			k = n;
+		memcpy(&r->tape->chunks[r->tape->last-1]->string[r->tapeFill], cells, k);
+		r->tapeFill += k;
+		cells += k;
+		n -= k;
+	}
+}
+
+/*****************************************************************
+ * Runs the machine on the string given to ndtm_run_append, then
+ * prepares an empty tape for the next one
+ *****************************************************************/
+char ndtm_run_execute(ndtm_run * r) {
+	if (r->tape->last == r->tape->first) {	// empty string: the head starts on a BLANK
+		appendTapeChunk(r, r->tape);
+		r->tape->chunks[r->tape->last-1]->string[0] = BLANK;
+		r->tapeFill = 1;
+	}
+	r->tape->low = 0;
+	r->tape->high = (r->tape->last - r->tape->first - 1) * r->chunkLength + r->tapeFill - 1;
+	r->tape->pointers_num = 0;
+
+	r->acceptString = false;
+	r->atLeastAnUndefinedPath = false;
+	r->currIteration = 1;
+	r->levelHead = 0;
+	r->stepsNum = 0;
+	r->budgetExceeded = NDTM_BUDGET_NONE;
+	clock_gettime(CLOCK_MONOTONIC, &r->startTime);
+	r->checkpointTime = r->startTime;
+	r->checkpointCheck = (r->reader == NULL) ? BUDGET_CHECK_PERIOD : LONG_MAX;	// streamed strings are not saved
+	if (r->checkpointPath != NULL || r->resumePending == true)
+		r->stringHash = hashTape(r, r->tape);
+
+	if (r->resumePending == true && r->stringHash == r->resumed.stringHash) {
+		// the loaded level replaces the beginning of the computation
+		freeTape(r, r->tape);
+		r->currIteration = r->resumed.currIteration;
+		r->stepsNum = r->resumed.stepsNum;
+		r->atLeastAnUndefinedPath = r->resumed.atLeastAnUndefinedPath;
+		r->startTime.tv_sec -= r->resumed.elapsed / 1000;
+		r->startTime.tv_nsec -= (r->resumed.elapsed % 1000) * 1000000;
+		if (r->startTime.tv_nsec < 0) {
+			r->startTime.tv_sec--;
+			r->startTime.tv_nsec += 1000000000;
+		}
+		r->checkpointCheck = r->stepsNum + BUDGET_CHECK_PERIOD;
+		r->resumePending = false;
+		executeLevels(r);
+	}
+	else {
+		if (r->resumePending == true) {		// the checkpoint belongs to another string
+			freeQueue(r);
+			r->resumePending = false;
+		}
+		r->currLevel->num = 0;
+		r->nextLevel->num = 0;
+		executeTM(r);
+	}
+	freeQueue(r);
+	if (r->checkpointPath != NULL)		// the string is over, its checkpoint is useless
+		endCheckpoints(r);
+
+	r->tape = newTape(r);
+	r->tapeFill = r->chunkLength;
+
+	if (r->budgetExceeded != NDTM_BUDGET_NONE)	// computation stopped before the answer was decided
+		r->atLeastAnUndefinedPath = true;
+
+	if (r->acceptString == true)             // at least a path accepts the string ---> ACCEPT STRING
+		return NDTM_ACCEPT;
+	else if (r->atLeastAnUndefinedPath == true)   // at least an undefined value ---> UNDEFINED
+		return NDTM_UNDEFINED;
+	return NDTM_REJECT;
+}
+
+/****************************************************************
+ * Runs the machine on a string read by the given reader: only the
+ * first chunk is read before starting the computation, the
+ * following ones when a head moves on them for the first time
+ ****************************************************************/
+char ndtm_run_stream(ndtm_run * r, ndtm_reader reader, void * data) {
+	r->reader = reader;
+	r->readerData = data;
+	r->inputEnded = false;
+
+	if (readInputChunk(r) == true)
+		ndtm_run_append(r, r->inputChunks[0], r->chunkLength);
+	char result = ndtm_run_execute(r);
+
+	for (int i = 0; i < r->inputChunksNum; i++)
+		free(r->inputChunks[i]);
+	r->inputChunksNum = 0;
+	r->reader = NULL;
+	r->inputEnded = true;
+	return result;
+}
+
+/****************************************************************
+ * Runs the given strings one after the other
+ ****************************************************************/
+int ndtm_run_batch(ndtm_run * r, const char * const * strings, const size_t * lengths, int n, char * results) {
+	int stopped = 0;
+	for (int i = 0; i < n; i++) {
+		results[i] = ndtm_run_string(r, strings[i], (lengths != NULL) ? lengths[i] : strlen(strings[i]));
+		if (r->budgetExceeded != NDTM_BUDGET_NONE)
+			stopped++;
+	}
+	return stopped;
+}
+
+//****************************************************************
+int ndtm_run_budget_exceeded(const ndtm_run * r) {
+	return r->budgetExceeded;
+}
+
+//****************************************************************
+long int ndtm_run_steps(const ndtm_run * r) {
+	return r->stepsNum;
+}
+
+/****************************************************************
+ * Frees the run and gives the memory of its pool back
+ ****************************************************************/
+void ndtm_run_free(ndtm_run * r) {
+	if (r->checkpointPath != NULL)
+		endCheckpoints(r);
+	free(r->checkpointPath);
+	free(r->checkpointTemp);
+	if (r->resumePending == true)
+		freeQueue(r);
+	freeTape(r, r->tape);
+	while (r->freeTapes != NULL) {
+		tm_tape * t = r->freeTapes;
+		r->freeTapes = t->next;
+		free(t->chunks);
+		free(t);
+	}
+	freeLevel(&r->levels[0]);
+	freeLevel(&r->levels[1]);
+	for (int i = 0; i < r->slabsNum; i++)
+		munmap(r->slabs[i], r->slabDims[i]);
+	free(r->slabs);
+	free(r->slabDims);
+	free(r->inputChunks);
+	free(r->canAccept);
+	free(r);
+}
+
+/*****************************************************************
+ * Saves the search state to the given file every period
+ * milliseconds, with the given label, until the current string
+ * ends. A NULL path stops the checkpoints.
+ *****************************************************************/
+void ndtm_run_set_checkpoint(ndtm_run * r, const char * path, long int period, long int label) {
+	if (r->checkpointPath != NULL && (path == NULL || strcmp(path, r->checkpointPath) != 0)) {
+		endCheckpoints(r);
+		free(r->checkpointPath);
+		free(r->checkpointTemp);
+		r->checkpointPath = NULL;
+		r->checkpointTemp = NULL;
+	}
+	if (path != NULL && r->checkpointPath == NULL) {
+		r->checkpointPath = strdup(path);
+		r->checkpointTemp = (char *) malloc(strlen(path) + 5);
+		sprintf(r->checkpointTemp, "%s.tmp", path);
+		r->fingerprint = hashMachine(r->machine);
+	}
+	r->checkpointPeriod = period;
+	r->checkpointLabel = label;
+}
+
+/*****************************************************************
+ * Loads the search state saved in the given file: the next string
+ * continues from it if it is the string of the checkpoint. Returns
+ * the label of the checkpoint, or -1 if the file can't be read or
+ * belongs to another machine.
+ *****************************************************************/
+long int ndtm_run_resume(ndtm_run * r, const char * path) {
+	const ndtm_machine * m = r->machine;
+	checkpoint_header h;
+	FILE * f = fopen(path, "rb");
+	if (f == NULL)
+		return -1;
+
+	if (fread(&h, sizeof(h), 1, f) != 1 || memcmp(h.magic, CHECKPOINT_MAGIC, 8) != 0 ||
+		h.fingerprint != hashMachine(m) || h.chunkLength != r->chunkLength) {
+		fclose(f);
+		return -1;
+	}
+
+	if (r->resumePending == true)
+		freeQueue(r);
+	r->currLevel->num = 0;
+	r->nextLevel->num = 0;
+	r->levelHead = 0;
+
+	tm_tape ** tapes = NULL;
+	int tapesNum = 0;
+	bool valid = true;
+	for (int i = 0; i < h.configurationsNum && valid == true; i++) {
+		int fields[6];		// state, read symbol, position in the list of the transitions, chunk, index, tape
+		valid = false;
+		if (fread(fields, sizeof(int), 6, f) != 6 || fields[0] < 0 || fields[0] >= m->states_num ||
+			m->graph[fields[0]].transitions == NULL || fields[1] < MIN_CHAR || fields[1] - MIN_CHAR >= POSSIBLE_CHARS_NUM ||
+			fields[5] < 0 || fields[5] > tapesNum)
+			break;
+		graph_node * p = m->graph[fields[0]].transitions[fields[1]-MIN_CHAR];
+		for (int k = 0; k < fields[2] && p != NULL; k++)
+			p = p->next;
+		if (p == NULL)
+			break;
+
+		if (fields[5] == tapesNum) {		// first configuration on this tape: the tape follows
+			int bounds[4];		// first and last chunk, window
+			if (fread(bounds, sizeof(int), 4, f) != 4 || bounds[0] > 0 || bounds[1] <= bounds[0] ||
+				bounds[2] < bounds[0] * r->chunkLength || bounds[2] >= (bounds[0] + 1) * r->chunkLength ||		// the window
+				bounds[3] < (bounds[1] - 1) * r->chunkLength || bounds[3] >= bounds[1] * r->chunkLength)		// touches each chunk
+				break;
+			tm_tape * t = newTape(r);
+			t->dim = bounds[1] - bounds[0];
+			t->chunks = (tape_chunk **) resizeArray(t->chunks, t->dim * sizeof(tape_chunk *));
+			t->origin = -bounds[0];
+			t->first = 0;
+			t->low = bounds[2];
+			t->high = bounds[3];
+			for (t->last = 0; t->last < t->dim; t->last++) {
+				int from, to;
+				windowOfChunk(r, t, t->last, &from, &to);
+				t->chunks[t->last] = allocChunk(r);
+				if (fread(&t->chunks[t->last]->string[from], 1, to - from + 1, f) != (size_t) (to - from + 1))
+					break;
+			}
+			tapes = (tm_tape **) realloc(tapes, (tapesNum + 1) * sizeof(tm_tape *));
+			tapes[tapesNum++] = t;
+			if (t->last != t->dim) {
+				t->last++;
+				break;
+			}
+		}
+		tm_tape * t = tapes[fields[5]];
+		if (fields[3] < t->first - t->origin || fields[3] >= t->last - t->origin || fields[4] < 0 || fields[4] >= r->chunkLength ||
+			fields[3] * r->chunkLength + fields[4] < t->low || fields[3] * r->chunkLength + fields[4] > t->high)
+			break;
+		putInLevel(r->currLevel, fields[0], p, tapes[fields[5]], fields[3], fields[4]);
+		valid = true;
+	}
+	fclose(f);
+
+	for (int i = 0; i < tapesNum; i++)		// tapes not used by any configuration (corrupted file)
+		if (tapes[i]->pointers_num == 0)
+			freeTape(r, tapes[i]);
+	free(tapes);
+
+	if (valid == false) {
+		freeQueue(r);
+		return -1;
+	}
+	r->resumed = h;
+	r->resumePending = true;
+	return h.label;
+}
+
+/*****************************************************************
+ * Starts a checkpoint if the period has passed since the last one
+ * and no other checkpoint is being written. The process is forked:
+ * the child writes its copy of the search state (copy on write)
+ * while the parent goes on computing.
+ *****************************************************************/
+static void checkpoint(ndtm_run * r) {
+	if (r->checkpointWriter != 0) {
+		if (waitpid(r->checkpointWriter, NULL, WNOHANG) == 0)
+			return;		// the previous checkpoint is still being written
+		r->checkpointWriter = 0;
+	}
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if ((now.tv_sec - r->checkpointTime.tv_sec) * 1000 + (now.tv_nsec - r->checkpointTime.tv_nsec) / 1000000 < r->checkpointPeriod)
+		return;
+	r->checkpointTime = now;
+
+	pid_t pid = fork();
+	if (pid == 0) {
+		writeCheckpoint(r);
+		_exit(0);
+	}
+	if (pid > 0)
+		r->checkpointWriter = pid;
+}
+
+/*****************************************************************
+ * Writes the current level to the checkpoint file. Each tape is
+ * written after the first configuration using it. Runs in the
+ * forked process, so it only uses system calls.
+ *****************************************************************/
+static void writeCheckpoint(ndtm_run * r) {
+	checkpoint_writer w;
+	checkpoint_header h;
+	struct timespec now;
+
+	w.fd = open(r->checkpointTemp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (w.fd < 0)
+		return;
+	w.used = 0;
+	w.failed = false;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, CHECKPOINT_MAGIC, 8);
+	h.fingerprint = r->fingerprint;
+	h.stringHash = r->stringHash;
+	h.label = r->checkpointLabel;
+	h.currIteration = r->currIteration;
+	h.stepsNum = r->stepsNum;
+	h.elapsed = (now.tv_sec - r->startTime.tv_sec) * 1000 + (now.tv_nsec - r->startTime.tv_nsec) / 1000000;
+	h.chunkLength = r->chunkLength;
+	h.configurationsNum = r->currLevel->num;
+	h.atLeastAnUndefinedPath = r->atLeastAnUndefinedPath;
+	putBytes(&w, &h, sizeof(h));
+
+	level * l = r->currLevel;
+	int tapesNum = 0;
+	for (int i = 0; i < l->num; i++) {
+		tm_tape * t = l->tapes[i];
+		graph_node * p = r->machine->graph[l->states[i]].transitions[l->transitions[i]->in-MIN_CHAR];
+		int fields[6] = { l->states[i], l->transitions[i]->in, 0, l->chunks[i], l->indexes[i], 0 };
+		for (; p != l->transitions[i]; p = p->next)
+			fields[2]++;
+
+		if (t->pointers_num > 0) {		// tape not written yet: its number is kept in pointers_num (this is a copy)
+			fields[5] = tapesNum;
+			t->pointers_num = -1 - tapesNum++;
+			putBytes(&w, fields, sizeof(fields));
+			int bounds[4] = { t->first - t->origin, t->last - t->origin, t->low, t->high };
+			putBytes(&w, bounds, sizeof(bounds));
+			for (int k = t->first; k < t->last; k++) {		// the cells of the window
+				int from, to;
+				windowOfChunk(r, t, k, &from, &to);
+				putBytes(&w, &t->chunks[k]->string[from], to - from + 1);
+			}
+		}
+		else {
+			fields[5] = -1 - t->pointers_num;
+			putBytes(&w, fields, sizeof(fields));
+		}
+	}
+
+	flushBytes(&w);
+	if (close(w.fd) != 0 || w.failed == true || rename(r->checkpointTemp, r->checkpointPath) != 0)
+		unlink(r->checkpointTemp);
+}
+
+/*****************************************************************
+ * Adds bytes to the buffer of the checkpoint, writing it when full
+ *****************************************************************/
+static void putBytes(checkpoint_writer * w, const void * bytes, size_t n) {
+	while (n > 0) {
+		size_t k = CHECKPOINT_BUFFER_DIM - w->used;
+		if (k > n)
+			k = n;
+		memcpy(&w->buffer[w->used], bytes, k);
+		w->used += k;
+		bytes = (const char *) bytes + k;
+		n -= k;
+		if (w->used == CHECKPOINT_BUFFER_DIM)
+			flushBytes(w);
+	}
+}
+
+/*****************************************************************
+ * Writes the buffer of the checkpoint to its file
+ *****************************************************************/
+static void flushBytes(checkpoint_writer * w) {
+	for (size_t done = 0; done < w->used; ) {
+		ssize_t written = write(w->fd, &w->buffer[done], w->used - done);
+		if (written <= 0) {
+			w->failed = true;
+			break;
+		}
+		done += written;
+	}
+	w->used = 0;
+}
+
+/*****************************************************************
+ * Waits for the checkpoint being written and removes the file
+ *****************************************************************/
+static void endCheckpoints(ndtm_run * r) {
+	if (r->checkpointWriter != 0) {
+		waitpid(r->checkpointWriter, NULL, 0);
+		r->checkpointWriter = 0;
+	}
+	unlink(r->checkpointPath);
+	unlink(r->checkpointTemp);
+}
+
+/*****************************************************************
+ * Hash of the machine: a checkpoint is resumed only by the machine
+ * that wrote it
+ *****************************************************************/
+static unsigned long hashMachine(const ndtm_machine * m) {
+	unsigned long h = FNV_OFFSET;
+	long int fields[4] = { m->states_num, m->iterationsLimit, 0, 0 };
+
+	h = hashBytes(h, fields, 2 * sizeof(long int));
+	for (int i = 0; i < m->states_num; i++) {
+		fields[0] = i;
+		fields[1] = (m->graph[i].isAccState == true);
+		h = hashBytes(h, fields, 2 * sizeof(long int));
+		if (m->graph[i].transitions == NULL)
+			continue;
+		for (int j = 0; j < POSSIBLE_CHARS_NUM; j++) {
+			for (graph_node * p = m->graph[i].transitions[j]; p != NULL; p = p->next) {
+				fields[0] = p->in;
+				fields[1] = p->out;
+				fields[2] = p->move;
+				fields[3] = p->next_state;
+				h = hashBytes(h, fields, sizeof(fields));
+			}
+		}
+	}
+	return h;
+}
+
+/*****************************************************************
+ * Hash of the cells in the window of a tape (the string, before the
+ * computation)
+ *****************************************************************/
+static unsigned long hashTape(ndtm_run * r, tm_tape * t) {
+	unsigned long h = FNV_OFFSET;
+	for (int i = t->first; i < t->last; i++) {
+		int from, to;
+		windowOfChunk(r, t, i, &from, &to);
+		h = hashBytes(h, &t->chunks[i]->string[from], to - from + 1);
+	}
+	return h;
+}
+
+/*****************************************************************
+ * FNV-1a hash of the given bytes, starting from h
+ *****************************************************************/
+static unsigned long hashBytes(unsigned long h, const void * bytes, size_t n) {
+	for (size_t k = 0; k < n; k++) {
+		h ^= ((const unsigned char *) bytes)[k];
+		h *= FNV_PRIME;
+	}
+	return h;
+}
+
+/*****************************************************************
+ * Marks the states from which an acceptation state is reachable
+ *****************************************************************/
+static void computeAcceptingStates(ndtm_run * r) {
+	const ndtm_machine * m = r->machine;
+	bool changed = true;
+
+	r->canAccept = (bool *) malloc((m->states_num + 1) * sizeof(bool));
+	for (int i = 0; i < m->states_num; i++)
+		r->canAccept[i] = m->graph[i].isAccState;
+
+	while (changed == true) {
+		changed = false;
+		for (int i = 0; i < m->states_num; i++) {
+			if (r->canAccept[i] == true || m->graph[i].transitions == NULL)
+				continue;
+			for (int j = 0; j < POSSIBLE_CHARS_NUM && r->canAccept[i] == false; j++) {
+				for (graph_node * p = m->graph[i].transitions[j]; p != NULL; p = p->next) {
+					if (r->canAccept[p->next_state] == true) {
+						r->canAccept[i] = true;
+						changed = true;
+						break;
+					}
+				}
+			}
+		}
+	}
+}
+
+/*****************************************************************
+ * Actually executes the Turing Machine on the tape of the run
+ *****************************************************************/
+static void executeTM(ndtm_run * r) {
+	startTM(r);
+	if (r->currLevel->num != 0)
+		executeLevels(r);
+}
+
+/****************************************************************
+ * Puts in the current level the transitions of the starting state
+ ****************************************************************/
+static void startTM(ndtm_run * r) {
+	const state * graph = r->machine->graph;
+	tm_tape * tape = r->tape;
+    int accessibleTransitions = 0;
+
+	if (graph[0].transitions == NULL) {	// no transitions from state 0
+		freeTape(r, tape);
+		return;
+	}
+	graph_node * p = graph[0].transitions[tape->chunks[tape->origin]->string[0]-MIN_CHAR];
+
+	// initialize for starting state (0) and starting index (0)
+	while (p != NULL) {
+		accessibleTransitions++;
+		if (accessibleTransitions >= 2)
+			putInLevel(r->currLevel, 0, p, copyTape(r, tape), 0, 0);
+		else
+			putInLevel(r->currLevel, 0, p, tape, 0, 0);
+		p = p->next;
+	}
+
+	if (r->currLevel->num == 0) // no possible transitions from state 0
+		freeTape(r, tape);
+}
+
+/****************************************************************
+ * Computes the levels, from the current one, until the result of
+ * the string is known
+ ****************************************************************/
+static void executeLevels(ndtm_run * r) {
+	const state * graph = r->machine->graph;	// locals: writes to the cells could alias the fields of the run
+	const bool * canAccept = r->canAccept;
+	const int chunkLength = r->chunkLength;
+	const long int iterationsLimit = r->machine->iterationsLimit;
+    int accessibleTransitions = 0;
+
+	while (r->currLevel->num != 0 && r->currIteration <= iterationsLimit) {
+
+		if (r->checkpointPath != NULL && r->stepsNum >= r->checkpointCheck) {	// between two levels the state is complete
+			r->checkpointCheck = r->stepsNum + BUDGET_CHECK_PERIOD;
+			checkpoint(r);
+		}
+
+		level * l = r->currLevel;
+		level * nextLevel = r->nextLevel;
+		int num = l->num;
+		int * states = l->states;			// the arrays of the current level do not move while it is computed
+		graph_node ** transitions = l->transitions;
+		int * chunks = l->chunks;
+		int * indexes = l->indexes;
+		tm_tape ** tapes = l->tapes;
+
+		for (int i = 0; i < num; i++) {
+
+			if (i + PREFETCH_DISTANCE < num) {	// cells and transitions of the following configurations
+				int k = i + PREFETCH_DISTANCE;
+				if (k + PREFETCH_DISTANCE < num)
+					__builtin_prefetch(tapes[k + PREFETCH_DISTANCE]);
+				tm_tape * t = tapes[k];
+				__builtin_prefetch(&t->chunks[t->origin + chunks[k]]->string[indexes[k]], 1);
+				__builtin_prefetch(graph[transitions[k]->next_state].transitions);
+			}
+
+			graph_node * transition = transitions[i];
+			int next_state = transition->next_state;
+			r->stepsNum++;
+
+			if (graph[next_state].isAccState == true || checkBudget(r) == true)  { // accept string or stop computation
+				if (r->budgetExceeded == NDTM_BUDGET_NONE)
+					r->acceptString = true;
+				r->levelHead = i;
+				return;
+			}
+
+			// once the result is UNDEFINED, paths that can't reach an acceptation state can't change it anymore
+			else if ((r->atLeastAnUndefinedPath == true && canAccept[next_state] == false) ||
+					 (states[i] == next_state && (transition->in == BLANK || (transition->in == transition->out && transition->move == STOP)))) {
+				r->atLeastAnUndefinedPath = true;
+			}
+
+			else {
+
+				tm_tape * t = tapes[i];
+				char * cells = t->chunks[t->origin + chunks[i]]->string;
+
+				if (transition->in == cells[indexes[i]]) {
+
+					cells[indexes[i]] = transition->out;
+
+					int next_chunk = chunks[i];
+					int next_index = indexes[i] + transition->move;
+                    if (next_index == -1 || next_index == chunkLength)
+                        updateIndex(r, t, &next_chunk, &next_index);
+
+					if (graph[next_state].transitions != NULL) {
+						char * nextCells = t->chunks[t->origin + next_chunk]->string;
+						visitCell(t, nextCells, next_chunk * chunkLength + next_index, next_index);
+						char currChar = nextCells[next_index];
+						graph_node * p = graph[next_state].transitions[currChar-MIN_CHAR];
+
+						while (p != NULL) {
+							accessibleTransitions++;
+							if (accessibleTransitions >= 2)
+								putInLevel(nextLevel, next_state, p, copyTape(r, t), next_chunk, next_index);
+							else
+								putInLevel(nextLevel, next_state, p, t, next_chunk, next_index);
+							p = p->next;
+						}
+					}
+				}
+			}
+
+			releaseTape(r, tapes[i]);
+			accessibleTransitions = 0;
+		}
+
+		r->currLevel = nextLevel;
+		r->nextLevel = l;
+		l->num = 0;
+		r->currIteration++;
+	}
+
+	if (r->currIteration > iterationsLimit)   // undefined value for computation
+		r->atLeastAnUndefinedPath = true;
+}
+
+/*****************************************************************
+ * Returns true if the current string exceeded one of its budgets
+ *****************************************************************/
+static inline bool checkBudget(ndtm_run * r) {
+	if (r->stepsBudget != 0 && r->stepsNum > r->stepsBudget)
+		r->budgetExceeded = NDTM_BUDGET_STEPS;
+	else if (r->timeBudget != 0 && r->stepsNum % BUDGET_CHECK_PERIOD == 0) {
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if ((now.tv_sec - r->startTime.tv_sec) * 1000 + (now.tv_nsec - r->startTime.tv_nsec) / 1000000 > r->timeBudget)
+			r->budgetExceeded = NDTM_BUDGET_TIME;
+	}
+	return (r->budgetExceeded != NDTM_BUDGET_NONE) ? true : false;
+}
+
+/****************************************************************
+ * Frees the configurations not computed yet
+ ****************************************************************/
+static void freeQueue(ndtm_run * r) {
+	for (int i = r->levelHead; i < r->currLevel->num; i++)
+		releaseTape(r, r->currLevel->tapes[i]);
+	for (int i = 0; i < r->nextLevel->num; i++)
+		releaseTape(r, r->nextLevel->tapes[i]);
+	r->currLevel->num = 0;
+	r->nextLevel->num = 0;
+	r->levelHead = 0;
+}
+
+/****************************************************************
+* Allocates the arrays of an empty level
+*****************************************************************/
+static void initLevel(level * l) {
+	l->num = 0;
+	l->dim = DEFAULT_LEVEL_DIM;
+	l->states = (int *) resizeArray(NULL, l->dim * sizeof(int));
+	l->transitions = (graph_node **) resizeArray(NULL, l->dim * sizeof(graph_node *));
+	l->chunks = (int *) resizeArray(NULL, l->dim * sizeof(int));
+	l->indexes = (int *) resizeArray(NULL, l->dim * sizeof(int));
+	l->tapes = (tm_tape **) resizeArray(NULL, l->dim * sizeof(tm_tape *));
+}
+
+//****************************************************************
+static void freeLevel(level * l) {
+	free(l->states);
+	free(l->transitions);
+	free(l->chunks);
+	free(l->indexes);
+	free(l->tapes);
+}
+
+/****************************************************************
+* Appends a configuration to the given level, doubling its arrays
+* when they are full
+*****************************************************************/
+static inline void putInLevel(level * l, int state, graph_node * p, tm_tape * tape, int chunk, int index) {
+
+	if (l->num == l->dim) {
+		l->dim *= 2;
+		l->states = (int *) resizeArray(l->states, l->dim * sizeof(int));
+		l->transitions = (graph_node **) resizeArray(l->transitions, l->dim * sizeof(graph_node *));
+		l->chunks = (int *) resizeArray(l->chunks, l->dim * sizeof(int));
+		l->indexes = (int *) resizeArray(l->indexes, l->dim * sizeof(int));
+		l->tapes = (tm_tape **) resizeArray(l->tapes, l->dim * sizeof(tm_tape *));
+	}
+
+	l->states[l->num] = state;
+	l->transitions[l->num] = p;
+	l->chunks[l->num] = chunk;
+	l->indexes[l->num] = index;
+	l->tapes[l->num] = tape;
+	tape->pointers_num++;
+	l->num++;
+}
+
+/****************************************************************
+* Drops a reference to the given tape, freeing it with the last one
+*****************************************************************/
+static inline void releaseTape(ndtm_run * r, tm_tape * t) {
+	t->pointers_num--;
+	if (t->pointers_num == 0)
+		freeTape(r, t);
+}
+
+/*****************************************************************
+ * Returns a new tape without chunks
+ *****************************************************************/
+static tm_tape * newTape(ndtm_run * r) {
+	tm_tape * t = takeTape(r, DEFAULT_DIRECTORY_DIM);
+	t->origin = 0;
+	t->first = 0;
+	t->last = 0;
+	t->low = 0;
+	t->high = -1;
+	t->pointers_num = 0;
+	return t;
+}
+
+/*****************************************************************
+ * Appends to the tape a chunk from the pool (its cells are not
+ * initialized)
+ *****************************************************************/
+static tape_chunk * appendTapeChunk(ndtm_run * r, tm_tape * t) {
+	tape_chunk * new = allocChunk(r);
+
+	if (t->last == t->dim) {
+		t->dim *= 2;
+		t->chunks = (tape_chunk **) resizeArray(t->chunks, t->dim * sizeof(tape_chunk *));
+	}
+	t->chunks[t->last++] = new;
+
+    return new;
+}
+
+/****************************************************************
+ * Widens the window of the tape to the cell the head has reached,
+ * which becomes BLANK if it is visited for the first time
+ ****************************************************************/
+static inline void visitCell(tm_tape * t, char * cells, int cell, int index) {
+	if (cell < t->low) {
+		t->low = cell;
+		cells[index] = BLANK;
+	}
+	else if (cell > t->high) {
+		t->high = cell;
+		cells[index] = BLANK;
+	}
+}
+
+/****************************************************************
+ * Gives the cells of the chunk in the given slot of the directory
+ * that are in the window of the tape, from *from to *to (included)
+ ****************************************************************/
+static void windowOfChunk(ndtm_run * r, tm_tape * t, int slot, int * from, int * to) {
+	int start = (slot - t->origin) * r->chunkLength;
+	*from = (t->low > start) ? t->low - start : 0;
+	*to = (t->high < start + r->chunkLength - 1) ? t->high - start : r->chunkLength - 1;
+}
+
+/****************************************************************
+ * Moves the head position across the border of its chunk, adding
+ * a chunk to the tape if the head reaches it for the first time
+ ****************************************************************/
+static void updateIndex(ndtm_run * r, tm_tape * t, int * chunk, int * index) {
+
+    if (*index == -1) {
+        (*chunk)--;
+        *index = r->chunkLength-1;
+        if (t->origin + *chunk < t->first)
+            prependNewTapeChunk(r, t);
+    }
+    else if (*index == r->chunkLength) {
+        (*chunk)++;
+        *index = 0;
+        if (t->origin + *chunk == t->last)
+            appendNewTapeChunk(r, t);
+    }
+}
+
+/*****************************************************************
+ * Prepends to the tape a new BLANK chunk. When the directory has
+ * no free slots on the left, it doubles and its chunks move to the
+ * second half.
+ *****************************************************************/
+static void prependNewTapeChunk(ndtm_run * r, tm_tape * t) {
+	if (t->first == 0) {
+		tape_chunk ** chunks = (tape_chunk **) resizeArray(NULL, 2 * t->dim * sizeof(tape_chunk *));
+		memcpy(&chunks[t->dim + t->first], &t->chunks[t->first], (t->last - t->first) * sizeof(tape_chunk *));
+		free(t->chunks);
+		t->chunks = chunks;
+		t->origin += t->dim;
+		t->first += t->dim;
+		t->last += t->dim;
+		t->dim *= 2;
+	}
+	t->chunks[--t->first] = allocChunk(r);	// BLANK outside the window, its cells are not initialized
+}
+
+/*****************************************************************
+ * Appends to the tape a new chunk (BLANK, or with the next part of
+ * the input string when it is streamed: then the whole chunk is in
+ * the window)
+ *****************************************************************/
+static void appendNewTapeChunk(ndtm_run * r, tm_tape * t) {
+    tape_chunk * newChunk = allocChunk(r);
+	if (r->reader != NULL) {
+		char * input = getInputChunk(r, t->last - t->origin);
+		if (input != NULL) {
+			memcpy(newChunk->string, input, r->chunkLength);
+			t->high = (t->last - t->origin + 1) * r->chunkLength - 1;
+		}
+	}
+
+	if (t->last == t->dim) {
+		t->dim *= 2;
+		t->chunks = (tape_chunk **) resizeArray(t->chunks, t->dim * sizeof(tape_chunk *));
+	}
+	t->chunks[t->last++] = newChunk;
+}
+
+/*****************************************************************
+ * Takes a tape from the pool (or a new one), with a directory of
+ * at least dim slots. The tapes and the chunks of a run are only
+ * used by the thread of the run, and a released tape keeps its
+ * directory (unless it is larger than POOLED_DIRECTORY_DIM): most
+ * copies need neither malloc nor atomic operations.
+ *****************************************************************/
+static tm_tape * takeTape(ndtm_run * r, int dim) {
+	tm_tape * t = r->freeTapes;
+	if (t == NULL) {
+		t = (tm_tape *) malloc(sizeof(tm_tape));
+		if (t == NULL) {
+			fprintf(stderr, "out of memory\n");
+			exit(1);
+		}
+		t->chunks = NULL;
+		t->dim = 0;
+	}
+	else r->freeTapes = t->next;
+
+	if (t->dim < dim) {
+		free(t->chunks);
+		t->chunks = (tape_chunk **) resizeArray(NULL, dim * sizeof(tape_chunk *));
+		t->dim = dim;
+	}
+	return t;
+}
+
+/*****************************************************************
+ * Reallocates an array (a chunk directory, the arrays of a level)
+ * to the given bytes, exiting if there is not enough memory
+ *****************************************************************/
+static void * resizeArray(void * array, size_t bytes) {
+	array = realloc(array, bytes);
+	if (array == NULL) {
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+	return array;
+}
+
+/*****************************************************************
+ * Returns a copy of the given tape, chunk by chunk: only the cells
+ * in the window are copied. The chunks are put in the middle of
+ * the directory of the copy (which may come from the pool), so
+ * that it has free slots on both sides.
+ *****************************************************************/
+static tm_tape * copyTape(ndtm_run * r, tm_tape * currTape) {
+	int chunksNum = currTape->last - currTape->first;
+
+    tm_tape * newTape = takeTape(r, (2 * chunksNum > DEFAULT_DIRECTORY_DIM) ? 2 * chunksNum : DEFAULT_DIRECTORY_DIM);
+	newTape->first = (newTape->dim - chunksNum) / 2;
+	newTape->last = newTape->first + chunksNum;
+	newTape->origin = currTape->origin - currTape->first + newTape->first;
+	newTape->low = currTape->low;
+	newTape->high = currTape->high;
+	newTape->pointers_num = 0;
+
+	for (int i = 0; i < chunksNum; i++) {
+		int from, to;
+		windowOfChunk(r, currTape, currTape->first + i, &from, &to);
+		newTape->chunks[newTape->first + i] = allocChunk(r);
+		memcpy(&newTape->chunks[newTape->first + i]->string[from], &currTape->chunks[currTape->first + i]->string[from], to - from + 1);
+	}
+
+    return newTape;
+}
+
+ /*****************************************************************
+  * Gives the tape and its chunks back to the pool
+  *****************************************************************/
+static void freeTape(ndtm_run * r, tm_tape * t) {
+	for (int i = t->first; i < t->last; i++)
+		releaseChunk(r, t->chunks[i]);
+	if (t->dim > POOLED_DIRECTORY_DIM) {
+		free(t->chunks);
+		t->chunks = NULL;
+		t->dim = 0;
+	}
+	t->next = r->freeTapes;
+	r->freeTapes = t;
+}
+
+/*****************************************************************
+ * Takes a chunk from the pool. When the pool is empty a new slab
+ * is requested to the system (with huge pages if asked, falling
+ * back to normal pages with transparent huge pages) and chunks are
+ * cut from it as needed. Slabs are given back when the run is freed.
+ *****************************************************************/
+static tape_chunk * allocChunk(ndtm_run * r) {
+	if (r->freeChunks != NULL) {
+		tape_chunk * chunk = r->freeChunks;
+		r->freeChunks = chunk->next;
+		return chunk;
+	}
+
+	if (r->poolNext + r->chunkBlockDim > r->poolEnd) {
+		size_t slabDim = (r->chunkBlockDim + POOL_SLAB_DIM - 1) / POOL_SLAB_DIM * POOL_SLAB_DIM;
+		void * slab = MAP_FAILED;
+#ifdef MAP_HUGETLB
+		if (r->hugePages == true)
+			slab = mmap(NULL, slabDim, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+		if (slab == MAP_FAILED) {
+			slab = mmap(NULL, slabDim, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (slab == MAP_FAILED) {
+				fprintf(stderr, "out of memory\n");
+				exit(1);
+			}
+#ifdef MADV_HUGEPAGE
+			if (r->hugePages == true)
+				madvise(slab, slabDim, MADV_HUGEPAGE);
+#endif
+		}
+		if (r->slabsNum == r->slabsDim) {
+			r->slabsDim = (r->slabsDim == 0) ? 16 : 2 * r->slabsDim;
+			r->slabs = (void **) realloc(r->slabs, r->slabsDim * sizeof(void *));
+			r->slabDims = (size_t *) realloc(r->slabDims, r->slabsDim * sizeof(size_t));
+		}
+		r->slabs[r->slabsNum] = slab;
+		r->slabDims[r->slabsNum++] = slabDim;
+		r->poolNext = (char *) slab;
+		r->poolEnd = r->poolNext + slabDim;
+	}
+
+	tape_chunk * chunk = (tape_chunk *) r->poolNext;
+	r->poolNext += r->chunkBlockDim;
+	return chunk;
+}
+
+/*****************************************************************
+ * Gives a chunk back to the pool
+ *****************************************************************/
+static void releaseChunk(ndtm_run * r, tape_chunk * chunk) {
+	chunk->next = r->freeChunks;
+	r->freeChunks = chunk;
+}
+
+/****************************************************************
+ * Reads the next chunk of the streamed string. Returns false if
+ * the string has no more characters.
+ ****************************************************************/
+static bool readInputChunk(ndtm_run * r) {
+	char * chunk = (char *) malloc(r->chunkLength);
+	size_t i = 0;
+
+	while (i < (size_t) r->chunkLength && r->inputEnded == false) {
+		size_t n = r->reader(r->readerData, &chunk[i], r->chunkLength - i);
+		if (n == 0)
+			r->inputEnded = true;
+		i += n;
+	}
+
+	if (i == 0) {
+		free(chunk);
+		return false;
+	}
+	memset(&chunk[i], BLANK, r->chunkLength-i);
+
+	if (r->inputChunksNum == r->inputChunksDim) {
+		r->inputChunksDim = (r->inputChunksDim == 0) ? DEFAULT_INPUT_CHUNKS : 2 * r->inputChunksDim;
+		r->inputChunks = (char **) realloc(r->inputChunks, r->inputChunksDim * sizeof(char *));
+	}
+	r->inputChunks[r->inputChunksNum++] = chunk;
+	return true;
+}
+
+/****************************************************************
+ * Returns the given chunk of the streamed string, reading it if no
+ * head has reached it yet, or NULL if the string is shorter
+ ****************************************************************/
+static char * getInputChunk(ndtm_run * r, int number) {
+	while (number >= r->inputChunksNum && r->inputEnded == false)
+		if (readInputChunk(r) == false)
+			break;
+	return (number >= 0 && number < r->inputChunksNum) ? r->inputChunks[number] : NULL;
+}
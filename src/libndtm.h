@@ -0,0 +1,111 @@
+//
+//  libndtm.h
+//  ndtm
+//
+//  Simulator of non-deterministic Turing Machines as a library: the
+//  BFS algorithm with chunked tapes, without global state, so that
+//  many machines and many runs can live in the same process.
+//
+//  A machine is built once (from its transitions or from the text
+//  format of the simulator) and is never changed while runs use it.
+//  A run holds everything a computation needs (levels, tapes, chunk
+//  pool, budgets): a run is used by one thread at a time, different
+//  runs, even on the same machine, can be used by different threads.
+//
+
+#ifndef LIBNDTM_H
+#define LIBNDTM_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#define NDTM_ACCEPT              '1'
+#define NDTM_REJECT              '0'
+#define NDTM_UNDEFINED           'U'
+
+#define NDTM_BUDGET_NONE           0
+#define NDTM_BUDGET_STEPS          1		// the steps budget of the string has been exceeded
+#define NDTM_BUDGET_TIME           2		// the time budget of the string has been exceeded
+
+typedef struct ndtm_machine ndtm_machine;
+typedef struct ndtm_run ndtm_run;
+
+// Fills the next cells (at most n) of the string being streamed and
+// returns how many were filled, 0 when the string has ended
+typedef size_t (* ndtm_reader)(void * data, char * cells, size_t n);
+
+/*****************************************************************
+ * Machines
+ *****************************************************************/
+
+// Returns a machine without states, whose computations are
+// UNDEFINED after maxSteps steps
+ndtm_machine * ndtm_machine_new(long int maxSteps);
+
+// Adds a transition: reading in from state, writes out, moves the
+// head ('L', 'R' or 'S') and goes to nextState. Returns -1 if the
+// transition is not valid, 0 otherwise. States are any ids (they
+// need not be consecutive): the computations start from state 0.
+int ndtm_machine_add_transition(ndtm_machine * m, long int state, char in, char out, char move, long int nextState);
+
+// Makes state an acceptation state. Returns 0.
+int ndtm_machine_add_accepting(ndtm_machine * m, long int state);
+
+// Reads a machine in the input format of the simulator, up to and
+// including the word "run". Returns NULL if the input is malformed.
+ndtm_machine * ndtm_machine_read(FILE * f);
+
+void ndtm_machine_free(ndtm_machine * m);
+
+/*****************************************************************
+ * Runs
+ *****************************************************************/
+
+// Returns a run of the given machine. chunkLength is the number of
+// cells of the chunks of the tapes (0 for the default); with
+// hugePages != 0 the chunk pool is backed by huge pages.
+ndtm_run * ndtm_run_new(const ndtm_machine * m, int chunkLength, int hugePages);
+
+// Limits the steps (over all the paths) and the time (milliseconds)
+// of each string, 0 for no limit. A string that exceeds a budget is
+// UNDEFINED, unless a path has already accepted it.
+void ndtm_run_set_budget(ndtm_run * r, long int steps, long int time);
+
+// Returns the result (NDTM_ACCEPT, NDTM_REJECT or NDTM_UNDEFINED)
+// of the machine on the given string
+char ndtm_run_string(ndtm_run * r, const char * string, size_t length);
+
+// Appends cells to the string of the next computation, which
+// ndtm_run_execute starts: long strings can be given piece by piece
+void ndtm_run_append(ndtm_run * r, const char * cells, size_t n);
+char ndtm_run_execute(ndtm_run * r);
+
+// Like ndtm_run_string, but the string is read by the reader only
+// when a head reaches its cells: the part no head reaches is not read
+char ndtm_run_stream(ndtm_run * r, ndtm_reader reader, void * data);
+
+// Runs n strings and stores their results in results. If lengths is
+// NULL the strings are NUL terminated. Returns the number of strings
+// stopped by a budget.
+int ndtm_run_batch(ndtm_run * r, const char * const * strings, const size_t * lengths, int n, char * results);
+
+// Saves the search state of the current string (the BFS level, its
+// tapes, the counters) to path every period milliseconds, with the
+// given label; the file is removed when the string ends. A forked
+// process writes a copy on write snapshot, so the computation doesn't
+// stop. Streamed strings are not saved. A NULL path stops saving.
+void ndtm_run_set_checkpoint(ndtm_run * r, const char * path, long int period, long int label);
+
+// Loads a checkpoint of the same machine: if the next string is the
+// one of the checkpoint, its computation continues from there, with
+// the same result. Returns the label of the checkpoint, -1 if there
+// is no valid checkpoint in path.
+long int ndtm_run_resume(ndtm_run * r, const char * path);
+
+// Which budget, if any, stopped the last string, and the steps it took
+int ndtm_run_budget_exceeded(const ndtm_run * r);
+long int ndtm_run_steps(const ndtm_run * r);
+
+void ndtm_run_free(ndtm_run * r);
+
+#endif
@@ -10,207 +10,82 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include "libndtm.h"
+#include "perfcounters.h"
 
-#define ACCEPT                  '1'
-#define REJECT                  '0'
-#define UNDEFINED	            'U'
-#define BLANK 			        '_'
-#define RIGHT                    1
-#define LEFT  			        -1
-#define STOP  			         0
-#define DEFAULT_STATES_DIM     256
-#define STATES_INCREMENT       256
-#define POSSIBLE_CHARS_NUM	   127
-#define MIN_CHAR				 0
-#define QUEUE_DIM			   512
-#define TAPE_CHUNK_LENGTH	   512
+#define DEFAULT_INPUT_DIM      256
+#define CACHE_LINE_DIM			64
+#define PIPELINE_QUEUE_DIM	  1024		// slots of the queues between the stages of the pipeline (a power of 2)
+#define CHECKPOINT_DEFAULT_PERIOD 60	// seconds between two checkpoints
 
 typedef enum {true, false} bool;
 
-typedef struct graph_node {       // node of the graph
-	char in;
-	char out;
-	int move;
-	int next_state;
-	struct graph_node * next;     // list of all possible next states of the current one
-} graph_node;
-
-typedef struct state {
-	graph_node ** transitions;
-	bool isAccState;
-} state;
-
-typedef struct tape_chunk {
-    char * string;
-    struct tape_chunk * right;
-	struct tape_chunk * left;
-} tape_chunk;
-
-typedef struct tm_tape {
-	tape_chunk * head;
-    tape_chunk * currChunk;
-	int pointers_num;
-} tm_tape;
-
-typedef struct transition {
-  int state;
-  graph_node * transition;
-  int index;
-  tm_tape * tape;
-} transition;
-
-void init();
-void readMTStructure();
-void insertNodeInGraph(int, char, char, int, int);
+typedef struct spsc_queue {      // bounded lock-free queue with a single producer and a single consumer
+	void * slots[PIPELINE_QUEUE_DIM];
+	_Alignas(CACHE_LINE_DIM) _Atomic unsigned long head;   // next slot to be read, moved by the consumer only
+	_Alignas(CACHE_LINE_DIM) _Atomic unsigned long tail;   // next slot to be written, moved by the producer only
+} spsc_queue;
+
 void readInputStrings();
-tape_chunk * addTapeChunk(tm_tape *, char *);
-void initTapeChunk(tape_chunk *, int);
-void run();
-void executeTM();
-tm_tape * copyTape(tm_tape *);
-void putInTransitionsQueue(int, graph_node *, tm_tape *, int);
-void removeFromTransitionsQueue();
-tm_tape * updateIndex(tm_tape *, int *);
-void prependNewTapeChunk(tm_tape **);
-void appendNewTapeChunk(tape_chunk **);
-tape_chunk * createNewChunk();
-void printGraph();
-void printTape(tm_tape *);
-void printQueue();
-void freeGraph();
-void freeQueue();
-void freeTape(tape_chunk *);
-
-int states_num = 0;						    // the number of states of the TM
-int states_dim = DEFAULT_STATES_DIM;        // the actual size of states array (graph)
-state * graph;				                // array containing all the states read from input
-
-transition transitionsQueue[QUEUE_DIM];     // the queue of current possible transitions
-int queueHead;
-int queueTail;
-
-tm_tape * tape;                             // the tape of the Turing Machine
-
-int startingState = 0;                      // the starting state of the Turing Machine
-long int currIteration;				        // the current iteration
-long int iterationsLimit;                   // the limit to the iteration number (to avoid machine loop)
-
-bool acceptString = false;                  // true when a path accepts the input string
-bool atLeastAnUndefinedPath = false;        // true when at least a path returns UNDEFINED (iteration > iterationsLimit)
-
-int input_dim;							    // the current length of the inputString array
-char * inputString;						    // the string read from input
-
-int nodesNum = 0;                           // the number of nodes in the computation queue
-
-/***************************************************************
- * Initializes graph (states vector) elements to NULL
- ***************************************************************/
-void init() {
-    tape = (tm_tape *) malloc(sizeof(tm_tape));
-    tape->head = NULL;
-    tape->currChunk = NULL;
-	for(int i = 0; i < DEFAULT_STATES_DIM; i++) {
-		graph[i].transitions = NULL;
-		graph[i].isAccState = false;
-	}
-}
+void streamInputStrings();
+size_t readStreamedCells(void *, char *, size_t);
+void runPipeline();
+void * readerThread(void *);
+void * writerThread(void *);
+void pushQueue(spsc_queue *, void *);
+void * popQueue(spsc_queue *);
+void skipInputStrings(long int);
+void beginString();
+void endString(char);
+void emitResult(char);
 
-/*******************************************************************
- * Reads the stdin (MT structure) saving data in program structures
- *******************************************************************/
-void readMTStructure() {
-	int s = -1;
-	char inputChar = ' ';
-	char outputChar = ' ';
-	char move = ' ';
-	int next_s = -1;
-	char in[5];
-
-	scanf("%s", in);
-	if (strcmp(in, "tr") != 0)
-		exit(0);
+ndtm_machine * machine;					    // the machine read from input
+ndtm_run * run;							    // the computations of the machine (the simulator is in libndtm.c)
 
-	scanf("%s", in);
-	while (strcmp(in, "acc") != 0) { 	// cycle until find the word "acc"
-		sscanf(in, "%d", &s); 		 	// read state
-		scanf("%s", in);
-		inputChar = in[0];    		    // read input character
-		scanf("%s", in);
-		outputChar = in[0];   		 	// read output character
-		scanf("%s", in);				// read move
-		switch(in[0]) {
-			case 'R': move = RIGHT;
-					  break;
-			case 'L': move = LEFT;
-					  break;
-			case 'S': move = STOP;
-					  break;
-			default:  break;
-		}
-		scanf("%s", in);
-		sscanf(in, "%d", &next_s);   					// read next state
-		if (s >= states_num || next_s >= states_num) {	// maintain the maximum states number
-			if (s >= next_s)
-				states_num = s + 1;
-			else
-				states_num = next_s + 1;
-		}
-		if (states_num >= states_dim) {
-			int newDim = states_num + STATES_INCREMENT;
-			graph = (state *) realloc(graph, newDim * sizeof(state));
-			// re-initialize states vector (graph) with NULL in new positions
-			for (int i = states_dim; i < newDim; i++) {
-				graph[i].transitions = NULL;
-				graph[i].isAccState = false;
-			}
-			states_dim = newDim;
-		}
-		insertNodeInGraph(s, inputChar, outputChar, move, next_s);
-		scanf("%s", in);
-	}
+long int stepsBudget = 0;				    // maximum number of steps (over all the paths) for each string, 0 if unlimited
+long int timeBudget = 0;				    // maximum execution time (milliseconds) for each string, 0 if unlimited
+int stringsNum = 0;						    // the number of strings read so far
 
-	int accState;
-	scanf("%s", in);
-	while (strcmp(in, "max") != 0) { 	// read acceptation states
-		sscanf(in, "%d", &accState);
-		graph[accState].isAccState = true;
-		scanf("%s", in);
-	}
+int chunkLength = 0;					    // the number of cells of each chunk, 0 for the default of the library
+bool hugePages = false;					    // true to back the chunk pool with huge pages
 
-	scanf("%ld", &iterationsLimit);    // read maximum number of iterations
+bool pipelineMode = false;				    // true to read, run and write the strings in three threads
+spsc_queue stringsQueue;				    // strings read and not run yet
+spsc_queue resultsQueue;				    // results not written yet
 
-	scanf("%s", in);                   // read the word "run" to start computations
-	if (strcmp(in, "run") != 0)
-		exit(0);
-	else
-		getchar(); // consume '\n' character after "run" string
-}
+char * checkpointPath = NULL;			    // where the search state of the current string is saved (NULL if not saved)
+long int checkpointPeriod = CHECKPOINT_DEFAULT_PERIOD;
+bool resumeMode = false;				    // true to continue from the checkpoint
+
+bool streamInput = false;				    // true to read each string only when a head reaches it
+bool lineEnded;							    // true when the whole streamed string has been read
+
+perf_counters counters;					    // hardware counters of the phases (off unless -e is given)
 
 /****************************************************************
- * Reads the next input string from stdin
+ * Reads the input strings from stdin and runs them, passing each
+ * one to the simulator a piece at a time
  ****************************************************************/
 void readInputStrings() {
-    char inputString[TAPE_CHUNK_LENGTH]; // current input string
+    char inputString[DEFAULT_INPUT_DIM];     // current piece of the input string
 
     int i = 0;
-    char c = ' ';
+    int c = ' ';
 
     while (c != EOF) {
         c = getchar();
-        if (i == TAPE_CHUNK_LENGTH-1 && c != EOF && c != '\n') {
-            inputString[i] = '\0';
-            addTapeChunk(tape, inputString);
+        if (i == DEFAULT_INPUT_DIM && c != EOF && c != '\n') {
+            ndtm_run_append(run, inputString, i);
             i = 0;
         }
 
-        if (i != 0 && (c == '\n' || (c == EOF && inputString[i-1] != '\0'))) {
-            inputString[i] = '\0';
-            initTapeChunk(addTapeChunk(tape, inputString), i);
-            run();
-            tape = (tm_tape *) malloc(sizeof(tm_tape));
-            tape->head = NULL;
-            tape->currChunk = NULL;
+        if (i != 0 && (c == '\n' || c == EOF)) {
+            ndtm_run_append(run, inputString, i);
+            beginString();
+            endString(ndtm_run_execute(run));
             i = 0;
         }
         else if (c != EOF && c != '\n') {
@@ -220,313 +95,273 @@ void readInputStrings() {
     }
 }
 
-//*****************************************************************
-tape_chunk * addTapeChunk(tm_tape * t, char * string) {
-	tape_chunk * new = (tape_chunk *) malloc(sizeof(tape_chunk));
-	new->string = (char *) malloc(TAPE_CHUNK_LENGTH);
-
-	if (t->head == NULL)
-		t->head = new;
-
-	memcpy(new->string, string, TAPE_CHUNK_LENGTH);
-	new->left = t->currChunk;
-
-	if (t->currChunk != NULL)
-		t->currChunk->right = new;
-
-	new->right = NULL;
-	t->currChunk = new;
-
-    return t->currChunk;
-}
-
-/******************************************************************
-* Initializes a new tape chunk with BLANK characters
-*******************************************************************/
-void initTapeChunk(tape_chunk * chunk, int length) {
-	memset(&chunk->string[length], BLANK, TAPE_CHUNK_LENGTH-length);
-	chunk->string[TAPE_CHUNK_LENGTH-1] = '\0';
-}
-
-/******************************************************************
- * Inserts the graph_node read from stdin in the graph_nodes graph
- ******************************************************************/
-void insertNodeInGraph(int s, char in, char out, int m, int n_s) {
-
-	graph_node * new = (graph_node *) malloc(sizeof(graph_node));
-
-	new->in = in;
-	new->out = out;
-	new->move = m;
-	new->next_state = n_s;
-
-	if (graph[s].transitions == NULL) {   // insert when list is empty
-		graph[s].transitions = (graph_node **) malloc(POSSIBLE_CHARS_NUM * sizeof(graph_node *));
-		for (int i = 0; i < POSSIBLE_CHARS_NUM; i++)
-			graph[s].transitions[i] = NULL;
-		graph[s].transitions[in-MIN_CHAR] = new;
-		new->next = NULL;
-		return;
+/****************************************************************
+ * Runs the input strings reading each one only when a head reaches
+ * its cells. The part of a string never reached by the heads is
+ * skipped.
+ ****************************************************************/
+void streamInputStrings() {
+	int c;
+	while ((c = getchar()) != EOF) {
+		if (c == '\n')		// empty line
+			continue;
+		ungetc(c, stdin);
+
+		lineEnded = false;
+		beginString();
+		endString(ndtm_run_stream(run, readStreamedCells, NULL));
+
+		while (lineEnded == false) {
+			c = getchar();
+			if (c == '\n' || c == EOF)
+				lineEnded = true;
+		}
 	}
-
-	new->next = graph[s].transitions[in-MIN_CHAR];
-	graph[s].transitions[in-MIN_CHAR] = new;
-
 }
 
-//***************************************
-void run() {
-    tape->currChunk = tape->head;
-    tape->pointers_num = 0;
-
-    acceptString = false;
-    atLeastAnUndefinedPath = false;
-	currIteration = 1;
-	nodesNum = 0;
-	queueHead = 0;
-	queueTail = 0;
-
-    executeTM();
-	freeQueue();
-
-	if (acceptString == true)             // at least a path accpets the string ---> ACCEPT STRING
-        printf("%c\n", ACCEPT);
-	else if (atLeastAnUndefinedPath == true)   // at least an undefined value ---> UNDEFINED
-		printf("%c\n", UNDEFINED);
-	else printf("%c\n", REJECT);
+/****************************************************************
+ * Reads the next cells of the streamed string from stdin, up to
+ * the end of its line
+ ****************************************************************/
+size_t readStreamedCells(void * data, char * cells, size_t n) {
+	(void) data;
+	size_t i = 0;
+	int c;
+
+	while (i < n && lineEnded == false) {
+		c = getchar();
+		if (c == '\n' || c == EOF)
+			lineEnded = true;
+		else cells[i++] = c;
+	}
+	return i;
 }
 
-/*****************************************************************
- * Actually executes the Turing Machine on the given input
- *****************************************************************/
-void executeTM() {
-    int accessibleTransitions = 0;
-	graph_node * p = graph[0].transitions[tape->currChunk->string[0]-MIN_CHAR];
-
-	// initialize for starting state (0) and starting index (0)
-	while (p != NULL) {
-		accessibleTransitions++;
-		if (accessibleTransitions >= 2)
-			putInTransitionsQueue(0, p, copyTape(tape), 0);
-		else
-			putInTransitionsQueue(0, p, tape, 0);
-		p = p->next;
+/****************************************************************
+ * Runs the strings with three threads: the reader splits the input
+ * in strings, this thread (the executor) runs them one at a time
+ * on its run of the machine, and the writer
+ * prints the results, in input order. The threads are connected
+ * by two bounded lock-free queues.
+ ****************************************************************/
+void runPipeline() {
+	pthread_t reader, writer;
+
+	pthread_create(&reader, NULL, readerThread, NULL);
+	pthread_create(&writer, NULL, writerThread, NULL);
+
+	char * string;
+	while ((string = (char *) popQueue(&stringsQueue)) != NULL) {
+		beginString();
+		char result = ndtm_run_string(run, string, strlen(string));
+		free(string);
+		endString(result);
 	}
 
-	if (nodesNum == 0) return; // no possible transitions from state 0
-
-    // start algorithm
-	int currentTail = queueTail;
-	transition currTransition = transitionsQueue[queueHead];
-	accessibleTransitions = 0;
-
-	while (nodesNum != 0 && currIteration <= iterationsLimit) {
-
-		while (queueHead != currentTail) {
-
-			int next_state = currTransition.transition->next_state;
-
-			if (graph[next_state].isAccState == true)  { // accept string
-				acceptString = true;
-				return;
-			}
-
-			else if (currTransition.state == currTransition.transition->next_state && (currTransition.transition->in == BLANK || (currTransition.transition->in == currTransition.transition->out && currTransition.transition->move == STOP))) {
-				atLeastAnUndefinedPath = true;
-			}
-
-			else {
-
-				if (currTransition.transition->in == currTransition.tape->currChunk->string[currTransition.index]) {
-
-					currTransition.tape->currChunk->string[currTransition.index] = currTransition.transition->out;
-
-					int next_index = currTransition.index + currTransition.transition->move;
-                    if (next_index == -1 || next_index == TAPE_CHUNK_LENGTH-1)
-                        currTransition.tape = updateIndex(currTransition.tape, &next_index);
-
-					if (graph[next_state].transitions != NULL) {
-						char currChar = currTransition.tape->currChunk->string[next_index];
-						graph_node * p = graph[next_state].transitions[currChar-MIN_CHAR];
+	pushQueue(&resultsQueue, NULL);
+	pthread_join(reader, NULL);
+	pthread_join(writer, NULL);
+}
 
-						while (p != NULL) {
-							accessibleTransitions++;
-							if (accessibleTransitions >= 2)
-								putInTransitionsQueue(next_state, p, copyTape(currTransition.tape), next_index);
-							else
-								putInTransitionsQueue(next_state, p, currTransition.tape, next_index);
-							p = p->next;
-						}
-					}
-				}
+/****************************************************************
+ * Reads the input strings and passes them to the executor, then
+ * a NULL string marks the end of the input
+ ****************************************************************/
+void * readerThread(void * arg) {
+	(void) arg;
+	int dim = DEFAULT_INPUT_DIM;
+	char * string = (char *) malloc(dim);
+	int i = 0;
+	int c;
+
+	while ((c = getchar()) != EOF) {
+		if (c != '\n') {
+			if (i == dim - 1) {
+				dim *= 2;
+				string = (char *) realloc(string, dim);
 			}
-
-			removeFromTransitionsQueue();
-			currTransition = transitionsQueue[queueHead];
-			accessibleTransitions = 0;
+			string[i++] = c;
+		}
+		else if (i != 0) {
+			string[i] = '\0';
+			pushQueue(&stringsQueue, string);
+			dim = DEFAULT_INPUT_DIM;
+			string = (char *) malloc(dim);
+			i = 0;
 		}
-
-		currentTail = queueTail;
-		currTransition = transitionsQueue[queueHead];
-		currIteration++;
 	}
+	if (i != 0) {
+		string[i] = '\0';
+		pushQueue(&stringsQueue, string);
+	}
+	else free(string);
 
-	if (currIteration > iterationsLimit)   // undefined value for computation
-		atLeastAnUndefinedPath = true;
+	pushQueue(&stringsQueue, NULL);
+	return NULL;
 }
 
 /****************************************************************
-* Puts a new element in the queue passed as parameter
-*****************************************************************/
-void putInTransitionsQueue(int state, graph_node * p, tm_tape * tape, int index) {
-
-	transitionsQueue[queueTail].state = state;
-	transitionsQueue[queueTail].transition = p;
-	transitionsQueue[queueTail].index = index;
-	transitionsQueue[queueTail].tape = tape;
-	transitionsQueue[queueTail].tape->pointers_num++;
-
-	if (queueTail == QUEUE_DIM-1)
-		queueTail = 0;
-	else
-		queueTail++;
-
-	nodesNum++;
+ * Prints the results passed by the executor, flushing the output
+ * only when no result is ready
+ ****************************************************************/
+void * writerThread(void * arg) {
+	(void) arg;
+	void * result;
+
+	do {
+		if (atomic_load(&resultsQueue.head) == atomic_load(&resultsQueue.tail))
+			fflush(stdout);
+		result = popQueue(&resultsQueue);
+		if (result != NULL)
+			printf("%c\n", (char) (long) result);
+	} while (result != NULL);
+	fflush(stdout);
+	return NULL;
 }
 
 /****************************************************************
-* Removes the first element of the queue passed as parameter
-*****************************************************************/
-void removeFromTransitionsQueue() {
-
-	if (nodesNum == 0)
-		return;
-
-	transitionsQueue[queueHead].tape->pointers_num--;
-
-	if (transitionsQueue[queueHead].tape->pointers_num == 0) {
-		freeTape(transitionsQueue[queueHead].tape->head);
-		free(transitionsQueue[queueHead].tape);
-	}
-
-	if (queueHead == QUEUE_DIM-1)
-		queueHead = 0;
-	else
-		queueHead++;
-
-	nodesNum--;
+ * Appends an item to the queue, yielding while it is full
+ ****************************************************************/
+void pushQueue(spsc_queue * q, void * item) {
+	unsigned long tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+	while (tail - atomic_load_explicit(&q->head, memory_order_acquire) == PIPELINE_QUEUE_DIM)
+		sched_yield();
+	q->slots[tail & (PIPELINE_QUEUE_DIM - 1)] = item;
+	atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
 }
 
-//****************************************************************
-tm_tape * updateIndex(tm_tape * t, int * index) {
-
-    if (*index == -1) {
-        if (t->currChunk->left == NULL)
-            prependNewTapeChunk(&t);
-        t->currChunk = t->currChunk->left;
-        *index = TAPE_CHUNK_LENGTH-2;         // exclude the '\0'
-    }
-    else if (*index == TAPE_CHUNK_LENGTH-1) {
-        if (t->currChunk->right == NULL)
-            appendNewTapeChunk(&t->currChunk);
-        t->currChunk = t->currChunk->right;
-        *index = 0;
-    }
-
-    return t;
+/****************************************************************
+ * Removes the first item of the queue, yielding while it is empty
+ ****************************************************************/
+void * popQueue(spsc_queue * q) {
+	unsigned long head = atomic_load_explicit(&q->head, memory_order_relaxed);
+	while (atomic_load_explicit(&q->tail, memory_order_acquire) == head)
+		sched_yield();
+	void * item = q->slots[head & (PIPELINE_QUEUE_DIM - 1)];
+	atomic_store_explicit(&q->head, head + 1, memory_order_release);
+	return item;
 }
 
-/*****************************************************************
- * Prepends to a given tape_chunk a new one
- *****************************************************************/
-void prependNewTapeChunk(tm_tape ** t) {
-    tape_chunk * newChunk = createNewChunk();
-    newChunk->right = (*t)->currChunk;
-    ((*t)->currChunk)->left = newChunk;
-	(*t)->head = newChunk;
+/****************************************************************
+ * Skips the given number of input strings (they were run before
+ * the checkpoint)
+ ****************************************************************/
+void skipInputStrings(long int n) {
+	int c = '\n';
+	while (n > 0 && (c = getchar()) != EOF) {
+		if (c == '\n')
+			continue;
+		while (c != '\n' && c != EOF)
+			c = getchar();
+		stringsNum++;
+		n--;
+	}
 }
 
-/*****************************************************************
- * Appends to a given tape_chunk a new one
- *****************************************************************/
-void appendNewTapeChunk(tape_chunk ** current) {
-    tape_chunk * newChunk = createNewChunk();
-    (*current)->right = newChunk;
-    newChunk->left = *current;
+/****************************************************************
+ * Tells the simulator which string is going to be saved in the
+ * checkpoints. The results of the previous strings are written
+ * first, as a resumed run doesn't print them again.
+ ****************************************************************/
+void beginString() {
+	if (checkpointPath != NULL) {
+		fflush(stdout);
+		ndtm_run_set_checkpoint(run, checkpointPath, checkpointPeriod * 1000, stringsNum + 1);
+	}
+	perfStart(&counters);
 }
 
-/*****************************************************************
- * Creates a new BLANK tape_chunk
- *****************************************************************/
-tape_chunk * createNewChunk() {
-    tape_chunk * newChunk = (tape_chunk *) malloc(sizeof(tape_chunk));
-    newChunk->string = (char *) malloc(TAPE_CHUNK_LENGTH);
-    initTapeChunk(newChunk, 0);
-    newChunk->string[TAPE_CHUNK_LENGTH-1] = '\0';
-    newChunk->left = NULL;
-    newChunk->right = NULL;
-    return newChunk;
+/****************************************************************
+ * Reports the result of a string, and the budget that stopped it
+ ****************************************************************/
+void endString(char result) {
+	stringsNum++;
+	perfStop(&counters, stringsNum, PERF_EXECUTE);		// the library frees the levels of the string before returning
+	int budget = ndtm_run_budget_exceeded(run);
+	if (budget != NDTM_BUDGET_NONE)
+		fprintf(stderr, "string %d: %s budget exceeded\n", stringsNum, (budget == NDTM_BUDGET_STEPS) ? "steps" : "time");
+	emitResult(result);
 }
 
-/*****************************************************************
- * Returns a copy of the given tape
- *****************************************************************/
-tm_tape * copyTape(tm_tape * currTape) {
-
-    tape_chunk * p = currTape->head;
-    tape_chunk * current = NULL;
-    tm_tape * newTape = (tm_tape *) malloc(sizeof(tm_tape));
-    newTape->head = NULL;
-    newTape->currChunk = NULL;
-	newTape->pointers_num = 0;
-
-    while (p != NULL) {
-        tape_chunk * newChunk = addTapeChunk(newTape, p->string);
-        if (p == currTape->currChunk) {
-            current = newChunk;
-		}
-        p = p->right;
-    }
-
-    newTape->currChunk = current;
-
-    return newTape;
+/****************************************************************
+ * Prints the result of a string, or passes it to the writer
+ * thread in pipeline mode
+ ****************************************************************/
+void emitResult(char result) {
+	if (pipelineMode == true)
+		pushQueue(&resultsQueue, (void *) (long) result);
+	else printf("%c\n", result);
 }
 
- /*****************************************************************
-  * Frees the given tape
-  *****************************************************************/
-void freeTape(tape_chunk * head) {
- 	tape_chunk * prec = head;
- 	tape_chunk * succ = head;
- 	while (succ != NULL) {
- 		succ = succ->right;
- 		free(prec->string);
- 		free(prec);
- 		prec = succ;
- 	}
- }
-
-//***************************************************************
-void freeQueue() {
-	 int i = queueHead;
-	 while(i != queueTail) {
-	 	freeTape(transitionsQueue[i].tape->head);
-		free(transitionsQueue[i].tape);
-		if (i == QUEUE_DIM-1)
-			i = 0;
-		else
-			i++;
-	}
- }
-
 /**************************************************************
  * 						 Main function
  **************************************************************/
 int main(int argc, char * argv[]) {
-	graph = (state *) malloc(DEFAULT_STATES_DIM * sizeof(state));
-	init();
-	readMTStructure();
-	readInputStrings();
+	int opt;
+	FILE * countersFile = NULL;
+	while ((opt = getopt(argc, argv, "s:t:lk:Hpc:i:re:")) != -1) {
+		switch (opt) {
+			case 's': stepsBudget = atol(optarg);
+					  break;
+			case 't': timeBudget = atol(optarg);
+					  break;
+			case 'l': streamInput = true;
+					  break;
+			case 'k': chunkLength = atoi(optarg);
+					  if (chunkLength < 1) {
+						  fprintf(stderr, "chunk length must be positive\n");
+						  exit(1);
+					  }
+					  break;
+			case 'H': hugePages = true;
+					  break;
+			case 'p': pipelineMode = true;
+					  break;
+			case 'c': checkpointPath = optarg;
+					  break;
+			case 'i': checkpointPeriod = atol(optarg);
+					  break;
+			case 'r': resumeMode = true;
+					  break;
+			case 'e': countersFile = (strcmp(optarg, "-") == 0) ? stderr : fopen(optarg, "w");
+					  if (countersFile == NULL) {
+						  fprintf(stderr, "Error: can't write %s\n", optarg);
+						  exit(1);
+					  }
+					  break;
+			default:  fprintf(stderr, "Usage: %s [-s steps budget] [-t time budget (ms)] [-l] [-k chunk length] [-H] [-p] [-c checkpoint file] [-i checkpoint period (s)] [-r] [-e counters file] < input\n", argv[0]);
+					  exit(1);
+		}
+	}
+
+	if (countersFile != NULL)		// only this thread runs the strings, the threads of -p are not counted
+		perfOpen(&counters, countersFile, "ndtm_STATIC_QUEUE_iterative", 0);
+	perfStart(&counters);
+	machine = ndtm_machine_read(stdin);
+	if (machine == NULL)
+		exit(0);
+	run = ndtm_run_new(machine, chunkLength, (hugePages == true) ? 1 : 0);
+	perfStop(&counters, 0, PERF_PARSE);
+	ndtm_run_set_budget(run, stepsBudget, timeBudget);
+	if (resumeMode == true && checkpointPath != NULL) {
+		long int label = ndtm_run_resume(run, checkpointPath);
+		if (label > 0)
+			skipInputStrings(label - 1);
+		else fprintf(stderr, "no checkpoint in %s, starting from the first string\n", checkpointPath);
+	}
+
+	if (streamInput == true || checkpointPath != NULL)		// strings are read while they are run, or the results
+		pipelineMode = false;									// must be written before the next string starts
+	if (streamInput == true)
+		streamInputStrings();
+	else if (pipelineMode == true)
+		runPipeline();
+	else readInputStrings();
+
+	perfStart(&counters);
+	ndtm_run_free(run);
+	ndtm_machine_free(machine);
+	perfStop(&counters, 0, PERF_TEARDOWN);
+	perfClose(&counters);
 	return 0;
 }
@@ -9,7 +9,21 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <unistd.h>
+#include <time.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef JIT
+#include <dlfcn.h>
+#include <sys/wait.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#include "perfcounters.h"
 
 #define ACCEPT                  '1'
 #define REJECT                  '0'
@@ -19,12 +33,46 @@
 #define STOP  			         0
 #define BLANK 			        '_'
 #define DEFAULT_INPUT_DIM      256
-#define INPUT_INCREMENT		   128
+#define INPUT_GROWTH		     2		// the input array grows geometrically
 #define DEFAULT_PADDING_DIM     32
+#define DEFAULT_WRITES_DIM       8
 #define DEFAULT_STATES_DIM      32
-#define STATES_INCREMENT        32
+#define STATES_GROWTH			 2		// the states array grows geometrically
+#define TOKEN_DIM				32		// longest word of the machine description (state ids included)
 #define POSSIBLE_CHARS_NUM	   127
 #define DEBUG 					 0
+#define JIT_COMPILER		  "cc"		// compiler used to build the native code of the machine
+#define JIT_CACHE_DIR		  "ndtm"	// where shared objects are cached, in $XDG_CACHE_HOME (or ~/.cache)
+#define JIT_TEMP_DIR  "/tmp/ndtm_jit.XXXXXX"	// private directory used for a single run when there is no cache
+#define JIT_ABI_VERSION		     3		// bump when the generated code interface changes
+#define BUDGET_NONE				 0
+#define BUDGET_STEPS			 1		// the per-string steps budget has been exceeded
+#define BUDGET_TIME				 2		// the per-string time budget has been exceeded
+#define BUDGET_CHECK_PERIOD	  1024		// steps between two checks of the time budget and of a progress request
+#define SPILL_BUFFER_DIM	(1 << 20)	// stdio buffer of the spill files
+#define CACHE_DEFAULT_DIM	  1024		// results kept in memory (least recently used ones are evicted)
+#define CACHE_FILE_SLOTS	(1 << 16)	// slots of the on-disk results cache (a power of 2)
+#define CACHE_PROBES_NUM		 8		// slots probed in the on-disk cache before overwriting one
+#define CACHE_MAGIC		"NDTMRES1"	// first bytes of an on-disk cache file
+#define LOCKSTEP_LANES			 8		// strings advanced together by the lockstep engine
+#define LOCKSTEP_STRIDE		   128		// entries of each state in the lockstep table
+#define LOCKSTEP_NONE			-1		// no transition for a (state, symbol) pair
+#define LOCKSTEP_STATE_SHIFT	10		// the next state is packed in the entries above the symbol, the move and the acceptation
+#define LOCKSTEP_MAX_STATES (1 << (31 - LOCKSTEP_STATE_SHIFT))	// states whose entries fit in an int (and stay positive)
+#define SEEN_DEFAULT_DIM	  1024		// initial slots of the set of configurations of a level (a power of 2)
+#define SEEN_MIN_WIDTH			 4		// narrower levels are not checked for duplicates, little could be saved
+#define SEEN_SAMPLE_DIM		  1024		// checks over which the rate of the duplicates is measured (a wide level or many narrow ones)
+#define SEEN_HIT_RATIO		   100		// with less than a duplicate every SEEN_HIT_RATIO checks, the string is no longer checked
+#define STEPS_SLAB_DIM		  4096		// path steps allocated at a time for the witnesses
+#define RECORDS_SLAB_DIM	  1024		// transitions (and tapes) allocated at a time for the queues
+#define BEST_FIRST_NONE			 0		// levels are run in order (BFS)
+#define BEST_FIRST_STEPS		 1		// the shortest paths are followed first
+#define BEST_FIRST_DISTANCE		 2		// the paths closest to an acceptation state (in the graph of the states) first
+#define BEST_FIRST_PROGRESS		 3		// the paths whose head is farthest on the right first
+#define BEST_FIRST_SEEN_DIM	(1 << 20)	// configurations remembered by the best-first search before the set is emptied
+#define NO_DISTANCE		   INT_MAX		// distance of the states from which no acceptation state is reachable
+#define FNV_OFFSET	14695981039346656037UL
+#define FNV_PRIME		1099511628211UL
 
 typedef enum {true, false} bool;
 
@@ -39,13 +87,67 @@ typedef struct graph_node {       // node of the graph
 typedef struct state {
 	graph_node ** transitions;
 	bool isAccState;
+	bool canAccept;               // true if an acceptation state is reachable from this state
+	int acceptDistance;           // transitions to the nearest acceptation state, NO_DISTANCE if none
+	bool canMoveLeft;             // true if a LEFT move is reachable from this state
+	bool canMoveRight;            // true if a RIGHT move is reachable from this state
 } state;
 
-typedef struct tm_tape {
-	char * string;
+typedef struct tm_tape {         // the cells written by a path, on top of the input string
+	int * positions;              // sorted positions of the written cells (of the first cells of the runs with -R)
+	int * lengths;                // cells of each run, NULL unless the tapes are stored as runs
+	char * symbols;               // symbols contained in those cells (same memory block as positions)
+	int writesNum;
+	int writesDim;
+	int cursor;                   // slot of the last accessed cell (the head moves by one cell at a time),
+	                              // with -R the runs before it, the others are at the end of the arrays
 	int pointers_num;
+	struct tm_tape * next;        // next spare tape, while the tape is not used by any transition
+	unsigned long cellsHash;      // sums of the hashes of the written cells, kept up to date by writeTape
+	unsigned long cellsCheck;
 } tm_tape;
 
+typedef struct cache_entry {      // a result kept in memory
+	unsigned long hash;
+	char * string;
+	char result;
+	long int steps;
+	struct cache_entry * nextInBucket;
+	struct cache_entry * newer;       // list of the entries in order of use
+	struct cache_entry * older;
+} cache_entry;
+
+typedef struct cache_header {     // first bytes of the on-disk cache file
+	char magic[8];
+	unsigned long fingerprint;    // machine (transitions, acceptation states and max) the results belong to
+	long int slotsNum;
+} cache_header;
+
+typedef struct cache_slot {       // a result in the on-disk cache
+	unsigned long hash;           // 0 if the slot is empty
+	unsigned long check;          // second hash of the string, to tell colliding strings apart
+	long int steps;
+	int length;
+	char result;
+} cache_slot;
+
+typedef struct state_slot {      // an id of the input in the map of the states
+	long int id;
+	int index;                    // where the state is in the graph, -1 if the slot is empty
+} state_slot;
+
+typedef struct seen_slot {       // a configuration already reached in the current level
+	unsigned long hash;
+	unsigned long check;          // second hash, to tell colliding configurations apart
+	long int epoch;               // the slot is empty unless this is the current epoch
+} seen_slot;
+
+typedef struct path_step {       // a non-deterministic choice of a path, kept while a queued transition descends from it
+	struct path_step * parent;    // the previous choice of the path, NULL for the first one
+	graph_node * choice;          // the transition taken among the ones of the configuration
+	int refs;                     // steps and transitions whose parent is this step
+} path_step;
+
 typedef struct transition {
   int state;
   char in;
@@ -54,34 +156,121 @@ typedef struct transition {
   int next_state;
   int index;
   tm_tape * tape;
+  path_step * parent;             // the last choice of the path of this transition (NULL unless witnesses are written)
   struct transition * next;
 } transition;
 
+typedef struct frontier_entry {   // a transition of the best-first frontier
+	long int key;                 // priority given by the heuristic, the lowest is followed first
+	long int depth;               // the steps of the path, this transition included
+	transition * t;
+} frontier_entry;
+
 void initGraph();
 void readMTStructure();
 void insertNodeInGraph(int, char, char, int, int);
+int stateIndex(long int);
 void readInputStrings();
 void run();
 void executeTM();
-tm_tape * modifyTapeChar(tm_tape *, int, char);
+void executeBestFirst();
+void pushFrontier(transition **, long int);
+transition * popFrontier();
+void dropTransition(transition *);
+void startTM();
+bool executeLevels(int);
+bool levelReadsPast(int);
+void addToBatch();
+void runBatch();
+int compareBatchStrings(const void *, const void *);
+void runGroup(int, int, bool);
+transition * copyQueue(transition *, transition **);
+void buildLockstepTable();
+void runLockstep(int);
+void fillLane(int);
+void finishLane(int, char);
 tm_tape * copyTape(tm_tape *);
-void putInQueue(transition **, transition **, int, graph_node *, tm_tape *, int);
+int findCell(tm_tape *, int);
+char readTape(tm_tape *, int);
+void writeTape(tm_tape *, int, char);
+void freeTape(tm_tape *);
+void setSlots(tm_tape *, int *, int);
+void growSlots(tm_tape *);
+void copySlots(tm_tape *, tm_tape *);
+static inline int runSlot(tm_tape *, int);
+void moveGap(tm_tape *, int);
+int findRun(tm_tape *, int);
+char readRuns(tm_tape *, int);
+void writeRuns(tm_tape *, int, char);
+void insertRun(tm_tape *, int, int, int, char);
+void removeRun(tm_tape *, int);
+void hashRuns(tm_tape *, int, int, unsigned long *, unsigned long *);
+unsigned long hashRun(int, int, char, unsigned long, unsigned long *);
+void sumInputWeights();
+tm_tape * newTape();
+transition * newTransition();
+void releaseTransition(transition *);
+void putInQueue(transition **, transition **, int, graph_node *, tm_tape *, int, path_step *);
 void removeFromQueue(transition **, transition **);
-char * reallocTape(char *, int *);
 void printGraph();
 void printTape();
 void printQueue();
 void freeGraph();
 void freeQueue();
+unsigned long hashBytes(unsigned long, const void *, size_t);
+unsigned long hashMachine();
+void initCache();
+void openCacheFile(const char *);
+bool lookupResult(char *, int *);
+void storeResult(char, long int);
+bool isDeterministic();
+void generateMachineCode(FILE *);
+void loadMachineCode();
+bool openMachineCodeDir(char *, size_t, bool *);
+bool buildMachineCode(const char *, unsigned long, const char *);
+bool isPrivateFile(const char *, bool);
+void computeAcceptingStates();
+void minimizeMachine();
+void computeMoveDirections();
+bool isDuplicate(int, tm_tape *, int);
+void clearSeen();
+void resetPruning();
+static inline unsigned long hashCell(int, char, unsigned long);
+static inline unsigned long positionSum(int, unsigned long);
+static inline unsigned long symbolWeight(char, unsigned long);
+static inline unsigned long mixHash(unsigned long);
+int compareSignatures(const void *, const void *);
+int compareTuples(const void *, const void *);
+void freeTransitions(graph_node **);
+bool followPath(transition *);
+bool checkBudget();
+int checkJitTime();
+void requestProgress(int);
+void reportProgress();
+void spillQueue(transition **, transition **);
+transition * readSpilledTransition();
+void resetSpillFiles();
+path_step * newStep(path_step *, graph_node *);
+void releaseStep(path_step *);
+void resetSteps();
+void writeWitness(transition *);
 
 int states_num = 0;						// the number of states of the TM
 int states_dim = DEFAULT_STATES_DIM;    // the actual size of states array (graph)
 state * graph;				    // array containing all the states read from input
+long int * stateIds;					// the id of each state in the input (the graph is indexed densely)
+state_slot * stateSlots = NULL;			// map from the ids of the input to the indexes of the graph
+int stateSlotsDim = 0;
 
 transition * transitionsQueue = NULL;              // the queue of current possible transitions
 transition * transitionsQueueTail = NULL;
 
 tm_tape * tape;                            // the tape of the Turing Machine
+int inputLength;						// the length of the input string, shared by all the tapes
+bool tapeRuns = false;					// true to store the written cells of the tapes as runs of equal symbols
+int slotBytes = sizeof(int) + 1;		// bytes of a written cell (or of a run) of a tape
+unsigned long * inputHashSums = NULL;	// with -R, sums of the weights of the input cells before each cell (for the hashes of the runs)
+unsigned long * inputCheckSums = NULL;
 
 int startingState = 0;                  // the starting state of the Turing Machine
 long int currIteration;				// the current iteration
@@ -94,7 +283,99 @@ int input_dim;							// the current length of the inputString array
 char * inputString;						// the string read from input
 
 int copiesNum = 0;
-int reallocsNum = 0;
+
+long int stepsBudget = 0;				// maximum number of steps (over all the paths) for each string, 0 if unlimited
+long int timeBudget = 0;				// maximum execution time (milliseconds) for each string, 0 if unlimited
+long int stepsNum;						// the number of steps performed on the current string
+struct timespec startTime;				// when the computation of the current string started
+int budgetExceeded = BUDGET_NONE;		// which budget, if any, stopped the current computation
+int stringsNum = 0;						// the number of strings read so far
+
+long int memoryBudget = 0;				// maximum memory (bytes) used by the queues before spilling them to disk, 0 if unlimited
+long int frontierBytes = 0;				// memory currently used by the queued transitions and their tapes
+FILE * levelSpill = NULL;				// transitions of the current level spilled to disk (they come before the queued ones)
+FILE * nextLevelSpill = NULL;			// transitions of the next level spilled to disk
+long int levelSpilledNum = 0;			// the number of transitions still to be read from levelSpill
+long int nextLevelSpilledNum = 0;		// the number of transitions written to nextLevelSpill
+
+int cacheCapacity = CACHE_DEFAULT_DIM;	// maximum number of results kept in memory, 0 to disable the cache
+int cacheEntriesNum = 0;
+cache_entry ** cacheBuckets = NULL;		// hash table of the results kept in memory
+unsigned long cacheBucketsNum = 0;
+cache_entry * cacheNewest = NULL;		// most recently used result
+cache_entry * cacheOldest = NULL;		// least recently used result (the first to be evicted)
+unsigned long machineFingerprint;		// hash of the machine and of max, results of other machines are never reused
+unsigned long stringHash;				// hashes of the current input string
+unsigned long stringCheck;
+cache_header * cacheFile = NULL;		// on-disk cache mapped in memory (NULL if not used)
+cache_slot * cacheSlots = NULL;
+
+bool batchMode = false;					// true to run the whole input at once, sharing the common prefixes
+char ** batchStrings = NULL;			// the strings of the batch, in input order
+int * batchOrder;						// indexes of the strings to be run, in lexicographic order
+char * batchResults;
+long int * batchSteps;
+int * batchBudgets;						// which budget, if any, stopped the computation of each string
+int batchNum = 0;
+int batchDim = 0;
+
+bool lockstepMode = false;				// true to run many strings at once on a deterministic machine
+int * lockstepTable;					// (state, symbol) -> next state, written symbol, move and acceptation, packed
+int laneState[LOCKSTEP_LANES];			// the computations in the lanes of the lockstep engine
+int laneHead[LOCKSTEP_LANES];
+long int laneIteration[LOCKSTEP_LANES];
+int laneString[LOCKSTEP_LANES];			// index of the string in the lane, -1 if the lane is empty
+char * laneTape[LOCKSTEP_LANES];
+int laneDim[LOCKSTEP_LANES];
+struct timespec laneStart[LOCKSTEP_LANES];
+int laneNext;							// the next string of batchOrder to be put in a lane
+int lanePending;
+int lanesActive;
+
+bool minimize = true;					// true to merge the equivalent states before running the strings
+int * signatures;						// the signatures of the states during the minimization
+int * signatureStart;					// where the signature of each state begins
+
+bool pruneDuplicates = true;			// true to follow only once the configurations reached more than once in a level
+seen_slot * seenSlots = NULL;			// hash set of the configurations of the current level
+unsigned long seenDim = 0;
+unsigned long seenNum = 0;
+long int seenEpoch = 0;					// incremented to empty the set
+bool pruneString;						// false once the duplicates of the current string turned out too rare to pay for the check
+long int seenChecks = 0;				// checks and duplicates found since the last measure of their rate
+long int seenHits = 0;
+long int levelWidth;					// the number of transitions of the current level
+long int nextLevelWidth;				// the number of transitions put in the next level
+
+FILE * witnessFile = NULL;				// where the accepting paths are written (NULL if they are not)
+path_step ** stepSlabs = NULL;			// arena of the choices of the paths, STEPS_SLAB_DIM steps per slab
+int stepSlabsNum = 0;
+int stepSlabsDim = 0;
+int stepSlab = 0;						// the slab new steps are taken from
+int stepSlabUsed = 0;					// the steps of that slab already taken
+path_step * freeSteps = NULL;			// steps no longer reachable from the queue, reused first
+transition * spareTransitions = NULL;	// transitions removed from the queues, reused first
+tm_tape * spareTapes = NULL;			// tapes no longer used by any transition, reused first
+path_step ** witnessSteps = NULL;		// the choices of the accepting path, from the last one
+int witnessDim = 0;
+char * witnessTape = NULL;				// the tape of the accepting path while it is replayed
+int witnessTapeDim = 0;
+
+volatile sig_atomic_t progressRequested = 0;	// set by SIGUSR1 and by the heartbeat, the report is written between two steps
+unsigned int progressPeriod = 0;		// seconds between two progress reports, 0 to report only on SIGUSR1
+int reportString = -1;					// the string and the steps of the last progress report
+long int reportSteps;
+struct timespec reportTime;
+
+perf_counters counters;					// hardware counters of the phases (off unless -e is given)
+
+int heuristic = BEST_FIRST_NONE;		// how the transitions are ordered, BEST_FIRST_NONE for the levels of the BFS
+frontier_entry * frontier = NULL;		// binary heap of the transitions still to be followed by the best-first search
+long int frontierNum = 0;
+long int frontierDim = 0;
+
+// native code of the machine, compiled and loaded at runtime (only for deterministic machines)
+char (* jitExecute)(const char *, long int, long int *, int (*)()) = NULL;
 
 /***************************************************************
  * Initializes graph (states vector) elements to NULL
@@ -103,6 +384,7 @@ void initGraph() {
 	for(int i = 0; i < DEFAULT_STATES_DIM; i++) {
 		graph[i].transitions = NULL;
 		graph[i].isAccState = false;
+		graph[i].canAccept = false;
 	}
 }
 
@@ -110,25 +392,28 @@ void initGraph() {
  * Reads the stdin (MT structure) saving data in program structures
  *******************************************************************/
 void readMTStructure() {
-	int s = -1;
+	long int s = -1;
 	char inputChar = ' ';
 	char outputChar = ' ';
 	char move = ' ';
-	int next_s = -1;
-	char in[5];
+	long int next_s = -1;
+	char in[TOKEN_DIM];
+
+	stateIds = (long int *) malloc(states_dim * sizeof(long int));
+	stateIndex(startingState);		// the starting state is the first one, whatever comes first in the input
 
-	scanf("%s", in);
+	scanf("%31s", in);
 	if (strcmp(in, "tr") != 0)
 		exit(0);
 
-	scanf("%s", in);
+	scanf("%31s", in);
 	while (strcmp(in, "acc") != 0) { 	// cycle until find the word "acc"
-		sscanf(in, "%d", &s); 		 	// read state
-		scanf("%s", in);
+		sscanf(in, "%ld", &s); 		 	// read state
+		scanf("%31s", in);
 		inputChar = in[0];    		    // read input character
-		scanf("%s", in);
+		scanf("%31s", in);
 		outputChar = in[0];   		 	// read output character
-		scanf("%s", in);				// read move
+		scanf("%31s", in);				// read move
 		switch(in[0]) {
 			case 'R': move = RIGHT;
 					  break;
@@ -139,44 +424,81 @@ void readMTStructure() {
 			default:  printf("Invalid move character\n");
 					  break;
 		}
-		scanf("%s", in);
-		sscanf(in, "%d", &next_s);   					// read next state
-		if (s >= states_num || next_s >= states_num) {	// maintain the maximum states number
-			if (s >= next_s)
-				states_num = s + 1;
-			else
-				states_num = next_s + 1;
-		}
-		if (states_num >= states_dim) {
-			int newDim = states_num + STATES_INCREMENT;
-			graph = (state *) realloc(graph, newDim * sizeof(state));
-			// re-initialize states vector (graph) with NULL in new positions
-			for (int i = states_dim; i < newDim; i++) {
-				graph[i].transitions = NULL;
-				graph[i].isAccState = false;
-			}
-			states_dim = newDim;
-			if (DEBUG) printf("RIALLOCO VETTORE STATI (dim = %d)\n", states_dim);
-		}
-		insertNodeInGraph(s, inputChar, outputChar, move, next_s);
-		scanf("%s", in);
+		scanf("%31s", in);
+		sscanf(in, "%ld", &next_s);   					// read next state
+		int from = stateIndex(s);
+		insertNodeInGraph(from, inputChar, outputChar, move, stateIndex(next_s));
+		scanf("%31s", in);
 	}
 
-	int accState;
-	scanf("%s", in);
+	long int accState;
+	scanf("%31s", in);
 	while (strcmp(in, "max") != 0) { 	// read acceptation states
-		sscanf(in, "%d", &accState);
-		graph[accState].isAccState = true;
-		scanf("%s", in);
+		sscanf(in, "%ld", &accState);
+		graph[stateIndex(accState)].isAccState = true;
+		scanf("%31s", in);
 	}
 
 	scanf("%ld", &iterationsLimit);    // read maximum number of iterations
 
-	scanf("%s", in);                  // read the word "run" to start computations
+	scanf("%31s", in);                  // read the word "run" to start computations
 	if (strcmp(in, "run") != 0)
 		exit(0);
 	else
 		getchar(); // consume '\n' character after "run" string
+
+	free(stateSlots);
+	stateSlots = NULL;
+}
+
+/*****************************************************************
+ * Returns the index in the graph of the state with the given id,
+ * adding the state if it is new: the states are numbered densely,
+ * in order of appearance, so the memory doesn't depend on the ids
+ *****************************************************************/
+int stateIndex(long int id) {
+	if (2 * (states_num + 1) > stateSlotsDim) {		// keep the map at most half full
+		int oldDim = stateSlotsDim;
+		state_slot * old = stateSlots;
+		stateSlotsDim = (stateSlotsDim == 0) ? 2 * DEFAULT_STATES_DIM : 2 * stateSlotsDim;
+		stateSlots = (state_slot *) malloc(stateSlotsDim * sizeof(state_slot));
+		for (int i = 0; i < stateSlotsDim; i++)
+			stateSlots[i].index = -1;
+		for (int i = 0; i < oldDim; i++) {
+			if (old[i].index == -1)
+				continue;
+			unsigned long h = mixHash(old[i].id) & (stateSlotsDim - 1);
+			while (stateSlots[h].index != -1)
+				h = (h + 1) & (stateSlotsDim - 1);
+			stateSlots[h] = old[i];
+		}
+		free(old);
+	}
+
+	unsigned long h = mixHash(id) & (stateSlotsDim - 1);
+	while (stateSlots[h].index != -1) {
+		if (stateSlots[h].id == id)
+			return stateSlots[h].index;
+		h = (h + 1) & (stateSlotsDim - 1);
+	}
+
+	if (states_num == states_dim) {
+		int newDim = states_dim * STATES_GROWTH;
+		graph = (state *) realloc(graph, newDim * sizeof(state));
+		stateIds = (long int *) realloc(stateIds, newDim * sizeof(long int));
+		// re-initialize states vector (graph) with NULL in new positions
+		for (int i = states_dim; i < newDim; i++) {
+			graph[i].transitions = NULL;
+			graph[i].isAccState = false;
+			graph[i].canAccept = false;
+		}
+		states_dim = newDim;
+		if (DEBUG) printf("RIALLOCO VETTORE STATI (dim = %d)\n", states_dim);
+	}
+	stateSlots[h].id = id;
+	stateSlots[h].index = states_num;
+	stateIds[states_num] = id;
+	return states_num++;
 }
 
 /****************************************************************
@@ -194,7 +516,7 @@ void readInputStrings() {
 		c = getchar();
 		//printf("%d ", c);
 		if (i == input_dim && c != EOF) {
-			int newDim = input_dim + INPUT_INCREMENT;
+			int newDim = input_dim * INPUT_GROWTH;
 			inputString = (char *) realloc(inputString, newDim);
 			input_dim = newDim;
 			if (DEBUG) printf("RIALLOCO VETTORE INPUT (dim = %d)\n", input_dim);
@@ -203,8 +525,11 @@ void readInputStrings() {
 		if (i != 0 && (c == '\n' || (c == EOF && inputString[i-1] != '\0'))) {
 			inputString[i] = '\0';
 			if (DEBUG) printf("input string: %s\n", inputString);
-			if (inputString[i-1] != ' ' && inputString[i-1] != '\n')
-				run();
+			if (inputString[i-1] != ' ' && inputString[i-1] != '\n') {
+				if (batchMode == true)
+					addToBatch();
+				else run();
+			}
 			inputString = (char *) malloc(DEFAULT_INPUT_DIM);
 			input_dim = DEFAULT_INPUT_DIM;
 			i = 0;
@@ -216,6 +541,9 @@ void readInputStrings() {
 	}
 
 	free(inputString);
+
+	if (batchMode == true)
+		runBatch();
 }
 
 /******************************************************************
@@ -251,43 +579,455 @@ void insertNodeInGraph(int s, char in, char out, int m, int n_s) {
 
 //***************************************
 void run() {
-	tape = (tm_tape *) malloc(sizeof(tm_tape));
-	tape->string = (char *) malloc(strlen(inputString) + 1);
-	tape->pointers_num = 0;
-	strcpy(tape->string, inputString);
-	free(inputString);
-  acceptString = false;
-  atLeastAnUndefinedPath = false;
-	currIteration = 1;
-  executeTM();
+	char result;
+	int length;
+	stringsNum++;
+	stepsNum = 0;
+	budgetExceeded = BUDGET_NONE;
+
+	perfStart(&counters);
+	if (lookupResult(&result, &length) == true) {	// same string already run on this machine
+		perfStop(&counters, stringsNum, PERF_EXECUTE);
+		printf("%c\n", result);
+		free(inputString);
+		return;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &startTime);
+
+	if (jitExecute != NULL) {	// deterministic machine already compiled to native code
+		long int limit = iterationsLimit;
+		if (stepsBudget != 0 && stepsBudget < limit)	// a single path: steps and iterations coincide
+			limit = stepsBudget;
+		result = jitExecute(inputString, limit, &currIteration, (timeBudget != 0) ? checkJitTime : NULL);
+		if (result == UNDEFINED && budgetExceeded == BUDGET_NONE && limit < iterationsLimit)
+			budgetExceeded = BUDGET_STEPS;
+		acceptString = (result == ACCEPT) ? true : false;
+		atLeastAnUndefinedPath = (result == UNDEFINED) ? true : false;
+		stepsNum = currIteration - 1;
+		perfStop(&counters, stringsNum, PERF_EXECUTE);
+	}
+	else {
+		tape = newTape();
+		inputLength = length;
+		acceptString = false;
+		atLeastAnUndefinedPath = false;
+		currIteration = 1;
+		frontierBytes = 0;
+		resetPruning();
+		if (tapeRuns == true)
+			sumInputWeights();
+		executeTM();
+		perfStop(&counters, stringsNum, PERF_EXECUTE);
+		perfStart(&counters);
+		freeQueue();
+		resetSpillFiles();
+		resetSteps();
+		perfStop(&counters, stringsNum, PERF_TEARDOWN);
+	}
+
+	if (budgetExceeded != BUDGET_NONE) {	// computation stopped before the answer was decided
+		atLeastAnUndefinedPath = true;
+		fprintf(stderr, "string %d: %s budget exceeded\n", stringsNum, (budgetExceeded == BUDGET_STEPS) ? "steps" : "time");
+	}
+
 	if (acceptString == true)             // at least a path accpets the string ---> ACCEPT STRING
-        printf("%c\n", ACCEPT);
+		result = ACCEPT;
 	else if (atLeastAnUndefinedPath == true)   // at least an undefined value ---> UNDEFINED
-		printf("%c\n", UNDEFINED);
-	else printf("%c\n", REJECT);                        // only rejection values ---> REJECT STRING
-    freeQueue();
+		result = UNDEFINED;
+	else result = REJECT;                        // only rejection values ---> REJECT STRING
+
+	if (budgetExceeded == BUDGET_NONE)		// results cut by a budget are not final
+		storeResult(result, stepsNum);
+	free(inputString);
+	printf("%c\n", result);
+}
+
+/*****************************************************************
+ * Keeps the string just read for the batch computation
+ *****************************************************************/
+void addToBatch() {
+	if (batchNum == batchDim) {
+		batchDim = (batchDim == 0) ? DEFAULT_INPUT_DIM : 2 * batchDim;
+		batchStrings = (char **) realloc(batchStrings, batchDim * sizeof(char *));
+	}
+	batchStrings[batchNum++] = inputString;
+}
+
+//****************************************************************
+int compareBatchStrings(const void * a, const void * b) {
+	return strcmp(batchStrings[*(const int *) a], batchStrings[*(const int *) b]);
+}
+
+/*****************************************************************
+ * Runs all the strings of the batch. The strings not found in the
+ * cache are sorted, so that the ones sharing a prefix are
+ * contiguous: they are the leaves of a trie whose nodes are the
+ * ranges of strings with the same prefix. Then the results are
+ * printed in input order.
+ *****************************************************************/
+void runBatch() {
+	int pending = 0;
+	int length;
+
+	perfStart(&counters);
+	batchOrder = (int *) malloc(batchNum * sizeof(int));
+	batchResults = (char *) malloc(batchNum);
+	batchSteps = (long int *) malloc(batchNum * sizeof(long int));
+	batchBudgets = (int *) calloc(batchNum, sizeof(int));
+
+	for (int i = 0; i < batchNum; i++) {
+		inputString = batchStrings[i];
+		batchSteps[i] = -1;
+		if (lookupResult(&batchResults[i], &length) == false)
+			batchOrder[pending++] = i;
+	}
+	if (lockstepMode == true) {
+		if (pending != 0)
+			runLockstep(pending);
+	}
+	else if (pending != 0) {
+		qsort(batchOrder, pending, sizeof(int), compareBatchStrings);
+		stepsNum = 0;
+		budgetExceeded = BUDGET_NONE;
+		clock_gettime(CLOCK_MONOTONIC, &startTime);
+		acceptString = false;
+		atLeastAnUndefinedPath = false;
+		currIteration = 1;
+		frontierBytes = 0;
+		resetPruning();
+		runGroup(0, pending, false);
+	}
+	perfStop(&counters, 0, PERF_EXECUTE);		// the strings of the batch run together
+
+	for (int i = 0; i < batchNum; i++) {
+		stringsNum++;
+		inputString = batchStrings[i];
+		if (batchBudgets[i] != BUDGET_NONE)
+			fprintf(stderr, "string %d: %s budget exceeded\n", stringsNum, (batchBudgets[i] == BUDGET_STEPS) ? "steps" : "time");
+		else if (batchSteps[i] != -1 && lookupResult(&batchResults[i], &length) == false)
+			storeResult(batchResults[i], batchSteps[i]);
+		printf("%c\n", batchResults[i]);
+		free(batchStrings[i]);
+	}
+
+	free(batchStrings);
+	free(batchOrder);
+	free(batchResults);
+	free(batchSteps);
+	free(batchBudgets);
+}
+
+/*****************************************************************
+ * Runs the sorted strings from lo to hi (excluded), that share a
+ * prefix, with a single computation while the head stays inside
+ * the common prefix. Before a level would read past it, the queue
+ * is copied for each child of the trie node (the strings with the
+ * same symbol after the prefix) and their computation goes on
+ * from there. started is false until the starting state has been
+ * put in the queue (it reads the first cell).
+ *****************************************************************/
+void runGroup(int lo, int hi, bool started) {
+	char * first = batchStrings[batchOrder[lo]];
+	char * last = batchStrings[batchOrder[hi-1]];
+	int boundary = 0;
+
+	while (first[boundary] != '\0' && first[boundary] == last[boundary])
+		boundary++;
+	if (first[boundary] == last[boundary])		// all the strings are equal: no boundary
+		boundary = -1;
+
+	inputString = first;			// the cells before the boundary are the same for all the strings
+	inputLength = strlen(first);
+	if (tapeRuns == true)
+		sumInputWeights();
+
+	if (started == false && boundary != 0) {
+		tape = newTape();
+		startTM();
+		started = true;
+	}
+
+	if (started == true && executeLevels(boundary) == true) {
+		char result = REJECT;
+		if (acceptString == true)
+			result = ACCEPT;
+		else if (atLeastAnUndefinedPath == true || budgetExceeded != BUDGET_NONE)
+			result = UNDEFINED;
+		for (int k = lo; k < hi; k++) {
+			batchResults[batchOrder[k]] = result;
+			batchSteps[batchOrder[k]] = stepsNum;
+			batchBudgets[batchOrder[k]] = budgetExceeded;
+		}
+		freeQueue();
+		return;
+	}
+
+	transition * snapshot = transitionsQueue;
+	transition * snapshotTail = transitionsQueueTail;
+	long int iteration = currIteration;
+	long int steps = stepsNum;
+	bool undefined = atLeastAnUndefinedPath;
+	bool prune = pruneString;
+	struct timespec start = startTime;
+	struct timespec forkTime;
+	clock_gettime(CLOCK_MONOTONIC, &forkTime);
+
+	for (int a = lo, b; a < hi; a = b) {
+		char c = batchStrings[batchOrder[a]][boundary];
+		for (b = a + 1; b < hi && batchStrings[batchOrder[b]][boundary] == c; b++);
+
+		if (b == hi) {		// the last child takes the queue itself
+			transitionsQueue = snapshot;
+			transitionsQueueTail = snapshotTail;
+		}
+		else transitionsQueue = copyQueue(snapshot, &transitionsQueueTail);
+
+		currIteration = iteration;
+		stepsNum = steps;
+		atLeastAnUndefinedPath = undefined;
+		acceptString = false;
+		budgetExceeded = BUDGET_NONE;
+		pruneString = prune;
+
+		struct timespec now;		// the time spent by the siblings does not count
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		startTime.tv_sec = start.tv_sec + (now.tv_sec - forkTime.tv_sec);
+		startTime.tv_nsec = start.tv_nsec + (now.tv_nsec - forkTime.tv_nsec);
+		if (startTime.tv_nsec < 0) {
+			startTime.tv_nsec += 1000000000;
+			startTime.tv_sec--;
+		}
+		else if (startTime.tv_nsec >= 1000000000) {
+			startTime.tv_nsec -= 1000000000;
+			startTime.tv_sec++;
+		}
+
+		runGroup(a, b, started);
+	}
+}
+
+/*****************************************************************
+ * Returns a copy of the queue passed as parameter, each transition
+ * with its own copy of the tape
+ *****************************************************************/
+transition * copyQueue(transition * queue, transition ** tail) {
+	transition * head = NULL;
+	*tail = NULL;
+
+	for (transition * t = queue; t != NULL; t = t->next) {
+		transition * new = newTransition();
+		*new = *t;
+		new->tape = copyTape(t->tape);
+		new->tape->pointers_num = 1;
+		new->next = NULL;
+		if (new->parent != NULL)
+			new->parent->refs++;
+		frontierBytes += sizeof(transition) + sizeof(tm_tape) + new->tape->writesDim * slotBytes;
+		copiesNum++;
+
+		if (head == NULL)
+			head = new;
+		else (*tail)->next = new;
+		*tail = new;
+	}
+	return head;
+}
+
+/*****************************************************************
+ * Packs the transitions of a deterministic machine in a table with
+ * LOCKSTEP_STRIDE entries for each state: next state, written
+ * symbol, move and whether the next state accepts
+ *****************************************************************/
+void buildLockstepTable() {
+	lockstepTable = (int *) malloc(states_num * LOCKSTEP_STRIDE * sizeof(int));
+	for (int i = 0; i < states_num * LOCKSTEP_STRIDE; i++)
+		lockstepTable[i] = LOCKSTEP_NONE;
+
+	for (int i = 0; i < states_num; i++) {
+		if (graph[i].transitions == NULL)
+			continue;
+		for (int j = 0; j < POSSIBLE_CHARS_NUM; j++) {
+			graph_node * p = graph[i].transitions[j];
+			if (p != NULL)
+				lockstepTable[i * LOCKSTEP_STRIDE + j] = (p->next_state << LOCKSTEP_STATE_SHIFT) | ((p->out & 127) << 3) |
+						((p->move + 1) << 1) | (graph[p->next_state].isAccState == true);
+		}
+	}
+}
+
+/*****************************************************************
+ * Runs the pending strings of the batch on a deterministic machine,
+ * LOCKSTEP_LANES at a time: at each round every lane reads its
+ * symbol, all the (state, symbol) entries are looked up together
+ * (with a gather on AVX2) and each lane takes its step. A lane
+ * whose string is decided takes the next pending string.
+ *****************************************************************/
+void runLockstep(int pending) {
+	int symbols[LOCKSTEP_LANES];
+	int entries[LOCKSTEP_LANES];
+	long int limit = iterationsLimit;
+	long int rounds = 0;
+
+	if (stepsBudget != 0 && stepsBudget < limit)	// a single path: steps and iterations coincide
+		limit = stepsBudget;
+
+	laneNext = 0;
+	lanePending = pending;
+	lanesActive = 0;
+	for (int l = 0; l < LOCKSTEP_LANES; l++) {
+		laneTape[l] = NULL;
+		laneDim[l] = 0;
+		fillLane(l);
+	}
+
+	while (lanesActive > 0) {
+		for (int l = 0; l < LOCKSTEP_LANES; l++)
+			symbols[l] = (laneString[l] >= 0) ? (laneTape[l][laneHead[l]] & 127) : BLANK;
+
+#ifdef __AVX2__
+		__m256i states = _mm256_loadu_si256((__m256i *) laneState);
+		__m256i indexes = _mm256_add_epi32(_mm256_slli_epi32(states, 7), _mm256_loadu_si256((__m256i *) symbols));
+		_mm256_storeu_si256((__m256i *) entries, _mm256_i32gather_epi32(lockstepTable, indexes, 4));
+#else
+		for (int l = 0; l < LOCKSTEP_LANES; l++)
+			entries[l] = lockstepTable[laneState[l] * LOCKSTEP_STRIDE + symbols[l]];
+#endif
+
+		bool checkTime = (timeBudget != 0 && ++rounds % BUDGET_CHECK_PERIOD == 0) ? true : false;
+
+		for (int l = 0; l < LOCKSTEP_LANES; l++) {
+			int e = entries[l];
+			if (laneString[l] < 0)
+				continue;
+			if (laneIteration[l] > limit)
+				finishLane(l, UNDEFINED);
+			else if (e == LOCKSTEP_NONE)
+				finishLane(l, REJECT);
+			else if (e & 1)
+				finishLane(l, ACCEPT);
+			else {
+				laneTape[l][laneHead[l]] = (e >> 3) & 127;
+				laneIteration[l]++;
+				laneHead[l] += ((e >> 1) & 3) - 1;
+				laneState[l] = e >> LOCKSTEP_STATE_SHIFT;
+
+				if (laneHead[l] == laneDim[l]) {		// grow the tape on the right
+					laneTape[l] = (char *) realloc(laneTape[l], 2 * laneDim[l]);
+					memset(&laneTape[l][laneDim[l]], BLANK, laneDim[l]);
+					laneDim[l] *= 2;
+				}
+				else if (laneHead[l] < 0) {				// grow the tape on the left
+					laneTape[l] = (char *) realloc(laneTape[l], 2 * laneDim[l]);
+					memmove(&laneTape[l][laneDim[l]], laneTape[l], laneDim[l]);
+					memset(laneTape[l], BLANK, laneDim[l]);
+					laneHead[l] += laneDim[l];
+					laneDim[l] *= 2;
+				}
+
+				if (checkTime == true) {
+					struct timespec now;
+					clock_gettime(CLOCK_MONOTONIC, &now);
+					if ((now.tv_sec - laneStart[l].tv_sec) * 1000 + (now.tv_nsec - laneStart[l].tv_nsec) / 1000000 > timeBudget) {
+						batchBudgets[laneString[l]] = BUDGET_TIME;
+						finishLane(l, UNDEFINED);
+					}
+				}
+			}
+		}
+	}
+
+	for (int l = 0; l < LOCKSTEP_LANES; l++)
+		free(laneTape[l]);
+}
+
+/*****************************************************************
+ * Puts the next pending string in the given lane, or empties it
+ *****************************************************************/
+void fillLane(int l) {
+	if (laneNext == lanePending) {
+		laneString[l] = -1;
+		laneState[l] = 0;		// keeps the lookups of the empty lane inside the table
+		return;
+	}
+
+	laneString[l] = batchOrder[laneNext++];
+	char * string = batchStrings[laneString[l]];
+	int length = strlen(string);
+
+	if (laneDim[l] < length + 2 * DEFAULT_PADDING_DIM) {
+		laneDim[l] = length + 2 * DEFAULT_PADDING_DIM;
+		laneTape[l] = (char *) realloc(laneTape[l], laneDim[l]);
+	}
+	memset(laneTape[l], BLANK, laneDim[l]);
+	memcpy(&laneTape[l][DEFAULT_PADDING_DIM], string, length);
+	laneHead[l] = DEFAULT_PADDING_DIM;
+	laneState[l] = startingState;
+	laneIteration[l] = 1;
+	if (timeBudget != 0)
+		clock_gettime(CLOCK_MONOTONIC, &laneStart[l]);
+	lanesActive++;
+}
+
+/*****************************************************************
+ * Saves the result of the string in the given lane and fills the
+ * lane again
+ *****************************************************************/
+void finishLane(int l, char result) {
+	int i = laneString[l];
+	batchResults[i] = result;
+	batchSteps[i] = laneIteration[l] - 1;
+	if (result == UNDEFINED && laneIteration[l] <= iterationsLimit && batchBudgets[i] == BUDGET_NONE)
+		batchBudgets[i] = BUDGET_STEPS;		// stopped by the steps budget before max
+	lanesActive--;
+	fillLane(l);
 }
 
 //***************************************
 void executeTM() {
+	if (heuristic != BEST_FIRST_NONE) {
+		executeBestFirst();
+		return;
+	}
+	startTM();
+	executeLevels(-1);
+}
+
+/****************************************************************
+ * Puts in the queue the transitions of the starting state
+ ****************************************************************/
+void startTM() {
 
 	int accessibleTransitions = 0;
-	graph_node * p = graph[0].transitions[tape->string[0]];
+	graph_node * p = graph[0].transitions[(unsigned char) readTape(tape, 0)];
+	bool branch = (witnessFile != NULL && p != NULL && p->next != NULL) ? true : false;
 
 	// initialize for starting state (0) and starting index (0)
 	while (p != NULL) {
 		accessibleTransitions++;
+		path_step * step = (branch == true) ? newStep(NULL, p) : NULL;
 		if (accessibleTransitions >= 2) {
-			putInQueue(&transitionsQueue, &transitionsQueueTail, 0, p, copyTape(tape), 0);
+			putInQueue(&transitionsQueue, &transitionsQueueTail, 0, p, copyTape(tape), 0, step);
 			copiesNum++;
 		}
 		else
-			putInQueue(&transitionsQueue, &transitionsQueueTail, 0, p, tape, 0);
+			putInQueue(&transitionsQueue, &transitionsQueueTail, 0, p, tape, 0, step);
 		p = p->next;
 	}
 
 	/*if (accessibleTransitions == 0) // no accessible transitions from 0 ---> reject
 		return;*/
+}
+
+/****************************************************************
+ * Computes the levels of the queue. With a boundary (>= 0), stops
+ * before a level that would read an input cell at or past it and
+ * returns false, leaving that level in the queue. Returns true
+ * when the result of the string is known.
+ ****************************************************************/
+bool executeLevels(int boundary) {
+
+	int accessibleTransitions = 0;
 
     // start algorithm
 	transition * currTransition = transitionsQueue;
@@ -295,45 +1035,73 @@ void executeTM() {
 	transition * newQueueTail = NULL;
 	accessibleTransitions = 0;
 
-	while (transitionsQueue != NULL && currIteration <= iterationsLimit) {
+	// a fork of the batch engine may have run another string at this level: start a new set
+	clearSeen();
+	levelWidth = levelSpilledNum;
+	for (transition * t = transitionsQueue; t != NULL; t = t->next)
+		levelWidth++;
+	nextLevelWidth = 0;
+
+	while ((transitionsQueue != NULL || levelSpilledNum != 0) && currIteration <= iterationsLimit) {
+
+		if (boundary >= 0 && levelReadsPast(boundary) == true)
+			return false;
 
 		if (DEBUG) {
 			printQueue();
 			printf("iteration: %ld\n", currIteration);
 		}
 
-		while (currTransition != NULL) {
+		while (currTransition != NULL || levelSpilledNum != 0) {
+
+			if (levelSpilledNum != 0) {		// the spilled transitions of the level come before the queued ones
+				currTransition = readSpilledTransition();
+				currTransition->next = transitionsQueue;
+				transitionsQueue = currTransition;
+				if (transitionsQueueTail == NULL)
+					transitionsQueueTail = currTransition;
+			}
 
+			stepsNum++;
 			int next_state = currTransition->next_state;
-			if (graph[next_state].isAccState == true)  { // accept string
-				acceptString = true;
-				return;
+			if (graph[next_state].isAccState == true || checkBudget() == true)  { // accept string or stop computation
+				if (budgetExceeded == BUDGET_NONE) {
+					acceptString = true;
+					if (witnessFile != NULL)
+						writeWitness(currTransition);
+				}
+				if (newQueue != NULL) {		// leave the next level in the queue, so that it is freed too
+					transitionsQueueTail->next = newQueue;
+					transitionsQueueTail = newQueueTail;
+				}
+				return true;
 			}
 
 			else {
 				//char * currTape = currTransition->tape->string;
 
-				if (currTransition->in == currTransition->tape->string[currTransition->index]) {
+				if (currTransition->in == readTape(currTransition->tape, currTransition->index) && followPath(currTransition) == true) {
 
-					currTransition->tape->string[currTransition->index] = currTransition->out;
+					writeTape(currTransition->tape, currTransition->index, currTransition->out);
 
 					int next_index = currTransition->index + currTransition->move;
-					if (next_index == -1 || next_index == strlen(currTransition->tape->string)-1) {
-						currTransition->tape->string = reallocTape(currTransition->tape->string, &next_index);
-					}
 
-					if (graph[next_state].transitions != NULL) {
-						char currChar = currTransition->tape->string[next_index];
-						graph_node * p = graph[next_state].transitions[currChar];
+					if (graph[next_state].transitions != NULL && isDuplicate(next_state, currTransition->tape, next_index) == false) {
+						char currChar = readTape(currTransition->tape, next_index);
+						graph_node * p = graph[next_state].transitions[(unsigned char) currChar];
+						bool branch = (witnessFile != NULL && p != NULL && p->next != NULL) ? true : false;
 
 						while (p != NULL) {
 							accessibleTransitions++;
+							// only the choices are kept, the rest of the path is deterministic
+							path_step * step = (branch == true) ? newStep(currTransition->parent, p) : currTransition->parent;
 							if (accessibleTransitions >= 2) {
-								putInQueue(&newQueue, &newQueueTail, next_state, p, copyTape(currTransition->tape), next_index);
+								putInQueue(&newQueue, &newQueueTail, next_state, p, copyTape(currTransition->tape), next_index, step);
 								copiesNum++;
 							}
 							else
-								putInQueue(&newQueue, &newQueueTail, next_state, p, currTransition->tape, next_index);
+								putInQueue(&newQueue, &newQueueTail, next_state, p, currTransition->tape, next_index, step);
+							nextLevelWidth++;
 							p = p->next;
 						}
 					}
@@ -342,41 +1110,204 @@ void executeTM() {
 				currTransition = currTransition->next;
 				removeFromQueue(&transitionsQueue, &transitionsQueueTail);
 				accessibleTransitions = 0;
+
+				if (memoryBudget != 0 && frontierBytes > memoryBudget && newQueue != NULL)
+					spillQueue(&newQueue, &newQueueTail);
 			}
 		}
 
+		if (nextLevelSpilledNum != 0) {		// the spilled part of the next level becomes the current one
+			FILE * swap = levelSpill;
+			levelSpill = nextLevelSpill;
+			nextLevelSpill = swap;
+			levelSpilledNum = nextLevelSpilledNum;
+			nextLevelSpilledNum = 0;
+			rewind(levelSpill);
+			rewind(nextLevelSpill);			// old records are overwritten, the counters tell where the level ends
+		}
+
 		transitionsQueue = newQueue;
 		transitionsQueueTail = newQueueTail;
 		currTransition = transitionsQueue;
 		newQueue = NULL;
 		newQueueTail = NULL;
 		currIteration++;
+		levelWidth = nextLevelWidth;
+		nextLevelWidth = 0;
+		clearSeen();
 	}
 
 	if (currIteration > iterationsLimit)   // undefined value for computation
 		atLeastAnUndefinedPath = true;
+	return true;
+}
+
+/****************************************************************
+ * Follows the transitions in the order given by the heuristic
+ * instead of level by level: the frontier is a binary heap and
+ * each transition knows the length of its path. The result is the
+ * same as the BFS one, as a string is rejected (or undefined) only
+ * once the frontier is empty, but an accepting path that the
+ * heuristic likes is found without running the levels before it.
+ ****************************************************************/
+void executeBestFirst() {
+	transition * children = NULL;
+	transition * childrenTail = NULL;
+
+	startTM();
+	pushFrontier(&transitionsQueue, 1);
+	transitionsQueueTail = NULL;
+	clearSeen();
+
+	while (frontierNum > 0) {
+		transition * t = popFrontier();
+
+		if (currIteration > iterationsLimit) {		// the path is longer than max
+			atLeastAnUndefinedPath = true;
+			dropTransition(t);
+			continue;
+		}
+
+		stepsNum++;
+		int next_state = t->next_state;
+		if (graph[next_state].isAccState == true || checkBudget() == true) {	// accept string or stop computation
+			if (budgetExceeded == BUDGET_NONE) {
+				acceptString = true;
+				if (witnessFile != NULL)
+					writeWitness(t);
+			}
+			dropTransition(t);
+			break;
+		}
+
+		if (t->in == readTape(t->tape, t->index) && followPath(t) == true) {
+			writeTape(t->tape, t->index, t->out);
+			int next_index = t->index + t->move;
+
+			levelWidth = frontierNum;		// no levels: the set of the configurations is emptied when it gets too big
+			if (seenNum >= BEST_FIRST_SEEN_DIM)
+				clearSeen();
+
+			if (graph[next_state].transitions != NULL && isDuplicate(next_state, t->tape, next_index) == false) {
+				graph_node * p = graph[next_state].transitions[(unsigned char) readTape(t->tape, next_index)];
+				bool branch = (witnessFile != NULL && p != NULL && p->next != NULL) ? true : false;
+
+				for (bool first = true; p != NULL; p = p->next, first = false) {
+					path_step * step = (branch == true) ? newStep(t->parent, p) : t->parent;
+					putInQueue(&children, &childrenTail, next_state, p, (first == true) ? t->tape : copyTape(t->tape), next_index, step);
+				}
+				pushFrontier(&children, currIteration + 1);
+				childrenTail = NULL;
+			}
+		}
+		dropTransition(t);
+	}
+
+	for (long int i = 0; i < frontierNum; i++)		// stopped by an accepting path or by a budget
+		dropTransition(frontier[i].t);
+	frontierNum = 0;
 }
 
-/********************
+/****************************************************************
+ * Moves the transitions of the given list to the frontier, with
+ * the given path length, and orders them by the key of the
+ * heuristic (ties go to the shortest path)
+ ****************************************************************/
+void pushFrontier(transition ** list, long int depth) {
+	while (*list != NULL) {
+		transition * t = *list;
+		*list = t->next;
+		t->next = NULL;
+
+		if (frontierNum == frontierDim) {
+			frontierDim = (frontierDim == 0) ? DEFAULT_INPUT_DIM : 2 * frontierDim;
+			frontier = (frontier_entry *) realloc(frontier, frontierDim * sizeof(frontier_entry));
+		}
+
+		frontier_entry e;
+		e.depth = depth;
+		e.t = t;
+		if (heuristic == BEST_FIRST_DISTANCE)
+			e.key = graph[t->next_state].acceptDistance;
+		else if (heuristic == BEST_FIRST_PROGRESS)
+			e.key = -(long int) (t->index + t->move);
+		else e.key = depth;
+
+		long int i = frontierNum++;
+		while (i > 0) {
+			frontier_entry * parent = &frontier[(i - 1) / 2];
+			if (parent->key < e.key || (parent->key == e.key && parent->depth <= e.depth))
+				break;
+			frontier[i] = *parent;
+			i = (i - 1) / 2;
+		}
+		frontier[i] = e;
+	}
+}
 
-*********************/
-tm_tape * modifyTapeChar(tm_tape * currTape, int index, char out) {
-	if (currTape->string[index] != out && currTape->pointers_num >= 1) {
-		tm_tape * newTape = copyTape(currTape);
-		newTape->string[index] = out;
-		return newTape;
+/****************************************************************
+ * Removes the first transition of the frontier and returns it;
+ * currIteration becomes the length of its path
+ ****************************************************************/
+transition * popFrontier() {
+	transition * t = frontier[0].t;
+	currIteration = frontier[0].depth;
+
+	frontier_entry last = frontier[--frontierNum];
+	long int i = 0;
+	while (2 * i + 1 < frontierNum) {
+		long int c = 2 * i + 1;
+		if (c + 1 < frontierNum && (frontier[c+1].key < frontier[c].key ||
+				(frontier[c+1].key == frontier[c].key && frontier[c+1].depth < frontier[c].depth)))
+			c++;
+		if (last.key < frontier[c].key || (last.key == frontier[c].key && last.depth <= frontier[c].depth))
+			break;
+		frontier[i] = frontier[c];
+		i = c;
 	}
-	else
-		return currTape;
+	frontier[i] = last;
+	return t;
 }
 
 /****************************************************************
-* Returns a copy of the string passed as parameter
+ * Frees a transition that is not in a queue, with its tape if no
+ * other transition uses it
+ ****************************************************************/
+void dropTransition(transition * t) {
+	transition * tail = t;
+	removeFromQueue(&t, &tail);
+}
+
+/****************************************************************
+ * Returns true if a transition of the queue would move the head
+ * on a cell at or past the boundary (no path has reached those
+ * cells yet, so none of them has been written)
+ ****************************************************************/
+bool levelReadsPast(int boundary) {
+	for (transition * t = transitionsQueue; t != NULL; t = t->next)
+		if (t->index + t->move >= boundary)
+			return true;
+	return false;
+}
+
+/****************************************************************
+* Returns a copy of the tape passed as parameter: only the written
+* cells are copied, the input string is shared
 *****************************************************************/
 tm_tape * copyTape(tm_tape * currTape) {
-	tm_tape * newTape = (tm_tape *) malloc(sizeof(tm_tape));
-	newTape->string = (char *) malloc(strlen(currTape->string)+1);
-	strcpy(newTape->string, currTape->string);
+	tm_tape * newTape = spareTapes;
+	if (newTape == NULL)
+		newTape = (tm_tape *) malloc(sizeof(tm_tape));
+	else spareTapes = newTape->next;
+	newTape->writesNum = currTape->writesNum;
+	newTape->writesDim = DEFAULT_WRITES_DIM;		// a copy is written right away: it gets free slots, sized like growSlots does
+	while (newTape->writesDim <= currTape->writesNum)
+		newTape->writesDim *= 2;
+	newTape->cursor = currTape->cursor;
+	newTape->cellsHash = currTape->cellsHash;
+	newTape->cellsCheck = currTape->cellsCheck;
+	setSlots(newTape, (int *) malloc(newTape->writesDim * slotBytes), newTape->writesDim);
+	copySlots(newTape, currTape);
 	newTape->pointers_num = 0;
 
 	if (DEBUG) {
@@ -388,93 +1319,1615 @@ tm_tape * copyTape(tm_tape * currTape) {
 }
 
 /****************************************************************
-* Puts a new element in the queue passed as parameter
+* Returns the slot of the first written cell whose position is not
+* lower than index, trying the neighbours of the last accessed slot
+* before a binary search
 *****************************************************************/
-void putInQueue(transition ** queue, transition ** tail, int state, graph_node * p, tm_tape * tape, int index) {
+int findCell(tm_tape * t, int index) {
+	int * pos = t->positions;
+	int n = t->writesNum;
+	int c = (t->cursor > n) ? n : t->cursor;
+
+	for (int h = c; h <= c + 1 && h <= n; h++) {
+		if ((h == 0 || pos[h-1] < index) && (h == n || pos[h] >= index))
+			return t->cursor = h;
+	}
+	if (c > 0 && (c == 1 || pos[c-2] < index) && pos[c-1] >= index)
+		return t->cursor = c - 1;
+
+	int low = 0;
+	int high = n;
+	while (low < high) {
+		int mid = (low + high) / 2;
+		if (pos[mid] < index)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return t->cursor = low;
+}
 
-	transition * new = (transition *) malloc(sizeof(transition));
+/****************************************************************
+* Returns the symbol in the given cell: the written cells are
+* looked up first, then the input string
+*****************************************************************/
+char readTape(tm_tape * t, int index) {
+	if (tapeRuns == true)
+		return readRuns(t, index);
 
-	new->state = state;
-	new->in = p->in;
-	new->out = p->out;
-	new->move = p->move;
-	new->next_state = p->next_state;
-	new->index = index;
-	new->tape = tape;
-	new->tape->pointers_num++;
+	int slot = findCell(t, index);
 
-	if (*queue == NULL) {
-		*queue = new;
+	if (slot < t->writesNum && t->positions[slot] == index)
+		return t->symbols[slot];
+	if (index >= 0 && index < inputLength)
+		return inputString[index];
+	return BLANK;
+}
+
+/****************************************************************
+* Writes a symbol in the given cell, keeping in the written cells
+* only those that differ from the input string
+*****************************************************************/
+void writeTape(tm_tape * t, int index, char c) {
+	if (tapeRuns == true) {
+		writeRuns(t, index, c);
+		return;
 	}
 
-	if (*tail != NULL)
-		(*tail)->next = new;
+	int slot = findCell(t, index);
+	char original = (index >= 0 && index < inputLength) ? inputString[index] : BLANK;
 
-	new->next = NULL;
-	*tail = new;
+	if (slot < t->writesNum && t->positions[slot] == index) {
+		t->cellsHash -= hashCell(index, t->symbols[slot], FNV_OFFSET);
+		t->cellsCheck -= hashCell(index, t->symbols[slot], ~FNV_OFFSET);
+		if (c != original) {
+			t->symbols[slot] = c;
+			t->cellsHash += hashCell(index, c, FNV_OFFSET);
+			t->cellsCheck += hashCell(index, c, ~FNV_OFFSET);
+		}
+		else {		// back to the input symbol: forget the cell
+			t->writesNum--;
+			memmove(&t->positions[slot], &t->positions[slot+1], (t->writesNum - slot) * sizeof(int));
+			memmove(&t->symbols[slot], &t->symbols[slot+1], t->writesNum - slot);
+		}
+		return;
+	}
+
+	if (c == original)
+		return;
+
+	if (t->writesNum == t->writesDim)
+		growSlots(t);
+
+	memmove(&t->positions[slot+1], &t->positions[slot], (t->writesNum - slot) * sizeof(int));
+	memmove(&t->symbols[slot+1], &t->symbols[slot], t->writesNum - slot);
+	t->positions[slot] = index;
+	t->symbols[slot] = c;
+	t->writesNum++;
+	t->cellsHash += hashCell(index, c, FNV_OFFSET);
+	t->cellsCheck += hashCell(index, c, ~FNV_OFFSET);
 }
 
 /****************************************************************
-* Removes the first element of the queue passed as parameter
+* Points the arrays of the tape to a block of dim written cells (or
+* runs): the positions, the lengths of the runs and the symbols
 *****************************************************************/
-void removeFromQueue(transition ** queue, transition ** tail) {
+void setSlots(tm_tape * t, int * block, int dim) {
+	t->positions = block;
+	t->lengths = (tapeRuns == true) ? &block[dim] : NULL;
+	t->symbols = (char *) &block[(tapeRuns == true) ? 2 * dim : dim];
+}
 
-	if (queue == NULL)
-		return;
+/****************************************************************
+* Doubles the written cells (or runs) the tape can hold
+*****************************************************************/
+void growSlots(tm_tape * t) {
+	int newDim = (t->writesDim == 0) ? DEFAULT_WRITES_DIM : 2 * t->writesDim;
+	tm_tape old = *t;
+
+	if (t->pointers_num != 0)
+		frontierBytes += (newDim - t->writesDim) * slotBytes;
+	t->writesDim = newDim;
+	setSlots(t, (int *) malloc(newDim * slotBytes), newDim);
+	copySlots(t, &old);
+	free(old.positions);
+}
 
-	transition * toBeRemoved = *queue;
-	*queue = (*queue)->next;
+/****************************************************************
+* Copies the written cells (or runs) of a tape in the arrays of
+* another one, whose writesDim can hold them. With -R the runs
+* after the gap go at the end of the new arrays: a copy is made of
+* two blocks, whatever the position of the head.
+*****************************************************************/
+void copySlots(tm_tape * to, tm_tape * from) {
+	int front = (tapeRuns == true) ? from->cursor : from->writesNum;
+	int back = from->writesNum - front;
 
-	if (toBeRemoved == *tail)
-		*tail = NULL;
+	if (from->writesNum == 0)		// a new tape has no arrays yet
+		return;
+	memcpy(to->positions, from->positions, front * sizeof(int));
+	memcpy(to->symbols, from->symbols, front);
+	if (tapeRuns == false)
+		return;
+	memcpy(to->lengths, from->lengths, front * sizeof(int));
+	memcpy(&to->positions[to->writesDim - back], &from->positions[from->writesDim - back], back * sizeof(int));
+	memcpy(&to->lengths[to->writesDim - back], &from->lengths[from->writesDim - back], back * sizeof(int));
+	memcpy(&to->symbols[to->writesDim - back], &from->symbols[from->writesDim - back], back);
+}
 
-	toBeRemoved->next = NULL;
+/****************************************************************
+* Returns where the given run is in the arrays of a tape stored as
+* runs: they are a gap buffer, with the runs before the cursor at
+* their start and the others at their end
+*****************************************************************/
+static inline int runSlot(tm_tape * t, int slot) {
+	return (slot < t->cursor) ? slot : slot + t->writesDim - t->writesNum;
+}
 
-	if (DEBUG) printf("removed : %d %c %c %d %d %s %d\n", toBeRemoved->state, toBeRemoved->in, toBeRemoved->out, toBeRemoved->move, toBeRemoved->next_state, toBeRemoved->tape->string, toBeRemoved->index);
+/****************************************************************
+* Moves the gap of a tape stored as runs before the given run: the
+* runs between the cursor and that run go to the other side. The
+* head moves by one cell at a time, so the gap moves by a run.
+*****************************************************************/
+void moveGap(tm_tape * t, int slot) {
+	int gap = t->writesDim - t->writesNum;
+
+	if (gap != 0 && slot < t->cursor) {
+		int n = t->cursor - slot;
+		memmove(&t->positions[slot + gap], &t->positions[slot], n * sizeof(int));
+		memmove(&t->lengths[slot + gap], &t->lengths[slot], n * sizeof(int));
+		memmove(&t->symbols[slot + gap], &t->symbols[slot], n);
+	}
+	else if (gap != 0 && slot > t->cursor) {
+		int n = slot - t->cursor;
+		memmove(&t->positions[t->cursor], &t->positions[t->cursor + gap], n * sizeof(int));
+		memmove(&t->lengths[t->cursor], &t->lengths[t->cursor + gap], n * sizeof(int));
+		memmove(&t->symbols[t->cursor], &t->symbols[t->cursor + gap], n);
+	}
+	t->cursor = slot;
+}
 
-	toBeRemoved->tape->pointers_num--;
+/****************************************************************
+* Returns the slot of the first run that ends at index or after
+* it, like findCell for the cells, and moves the gap before it
+*****************************************************************/
+int findRun(tm_tape * t, int index) {
+	int * pos = t->positions;
+	int * len = t->lengths;
+	int n = t->writesNum;
+	int c = t->cursor;
+
+	#define RUN_END(h) (pos[runSlot(t, h)] + len[runSlot(t, h)] - 1)
+
+	for (int h = (c > 0) ? c - 1 : 0; h <= c + 1 && h <= n; h++) {
+		if ((h == 0 || RUN_END(h-1) < index) && (h == n || RUN_END(h) >= index)) {
+			moveGap(t, h);
+			return h;
+		}
+	}
 
-	if (toBeRemoved->tape->pointers_num == 0) {
-		free(toBeRemoved->tape->string);
-		free(toBeRemoved->tape);
+	int low = 0;
+	int high = n;
+	while (low < high) {
+		int mid = (low + high) / 2;
+		if (RUN_END(mid) < index)
+			low = mid + 1;
+		else
+			high = mid;
 	}
 
-	free(toBeRemoved);
+	#undef RUN_END
+	moveGap(t, low);
+	return low;
 }
 
 /****************************************************************
-* Reallocates the current tape of the Turing Machine
+* Returns the symbol in the given cell of a tape stored as runs
 *****************************************************************/
-char * reallocTape(char * currTape, int * index) {
+char readRuns(tm_tape * t, int index) {
+	int slot = runSlot(t, findRun(t, index));
+
+	if (slot < t->writesDim && t->positions[slot] <= index)
+		return t->symbols[slot];
+	if (index >= 0 && index < inputLength)
+		return inputString[index];
+	return BLANK;
+}
 
-	int length = strlen(currTape)+1;
+/****************************************************************
+* Writes a symbol in the given cell of a tape stored as runs: the
+* cell leaves its run (which may be split in two) and joins the
+* runs of the same symbol on its sides. A cell equal to the input
+* is stored only if it joins a run. The runs are edited next to
+* the gap, that findRun moved to the head, without moving the
+* others. The hashes weigh each cell by the difference between its
+* symbol and the input one, so that stored input symbols count 0.
+*****************************************************************/
+void writeRuns(tm_tape * t, int index, char c) {
+	int slot = findRun(t, index);
+	int r = runSlot(t, slot);
+	char original = (index >= 0 && index < inputLength) ? inputString[index] : BLANK;
+	bool inRun = (slot < t->writesNum && t->positions[r] <= index) ? true : false;
+	char old = (inRun == true) ? t->symbols[r] : original;
+
+	if (c == old)
+		return;
+	t->cellsHash += (symbolWeight(c, FNV_OFFSET) - symbolWeight(old, FNV_OFFSET)) * (positionSum(index + 1, FNV_OFFSET) - positionSum(index, FNV_OFFSET));
+	t->cellsCheck += (symbolWeight(c, ~FNV_OFFSET) - symbolWeight(old, ~FNV_OFFSET)) * (positionSum(index + 1, ~FNV_OFFSET) - positionSum(index, ~FNV_OFFSET));
+
+	if (inRun == true) {		// take the cell out of its run, slot becomes the first run after it
+		int start = t->positions[r];
+		int end = start + t->lengths[r] - 1;
+		if (start == end)
+			removeRun(t, slot);
+		else if (index == start) {
+			t->positions[r]++;
+			t->lengths[r]--;
+		}
+		else if (index == end) {
+			t->lengths[r]--;
+			slot++;
+		}
+		else {
+			insertRun(t, slot + 1, index + 1, end - index, old);
+			t->lengths[runSlot(t, slot)] = index - start;
+			slot++;
+		}
+	}
 
-	if (*index == -1) {
-		char * tapeCopy = (char *) malloc(length);
-		strcpy(tapeCopy, currTape);
-		currTape = realloc(currTape, length + DEFAULT_PADDING_DIM);
-		for (int i = 0; i < DEFAULT_PADDING_DIM; i++)
-			currTape[i] = BLANK;
-		strcpy(&currTape[DEFAULT_PADDING_DIM], tapeCopy);
-		free(tapeCopy);
+	int left = runSlot(t, slot - 1);
+	int right = runSlot(t, slot);
+	bool joinLeft = (slot > 0 && t->positions[left] + t->lengths[left] == index && t->symbols[left] == c) ? true : false;
+	bool joinRight = (slot < t->writesNum && t->positions[right] == index + 1 && t->symbols[right] == c) ? true : false;
+	if (joinLeft == true && joinRight == true) {
+		t->lengths[left] += 1 + t->lengths[right];
+		removeRun(t, slot);
+	}
+	else if (joinLeft == true)
+		t->lengths[left]++;
+	else if (joinRight == true) {
+		t->positions[right]--;
+		t->lengths[right]++;
+	}
+	else if (c != original)
+		insertRun(t, slot, index, 1, c);
+}
 
-		*index = *index + DEFAULT_PADDING_DIM;
-  }
-  else {
-		currTape = realloc(currTape, length + DEFAULT_PADDING_DIM);
-		for (int i = length-1; i < length + DEFAULT_PADDING_DIM; i++)
-			currTape[i] = BLANK;
-  }
+/****************************************************************
+* Inserts a run before the given one, at the end of the gap
+*****************************************************************/
+void insertRun(tm_tape * t, int slot, int start, int length, char c) {
+	if (t->writesNum == t->writesDim)
+		growSlots(t);
+	moveGap(t, slot);
+	int r = t->writesDim - t->writesNum + slot - 1;
+	t->positions[r] = start;
+	t->lengths[r] = length;
+	t->symbols[r] = c;
+	t->writesNum++;
+}
 
-	currTape[length+DEFAULT_PADDING_DIM-1] = '\0';
-	if (DEBUG) printf("\nRIALLOCO VETTORE TAPE (dim = %d)\n\n", (int) strlen(currTape));
-	reallocsNum++;
-	return currTape;
+/****************************************************************
+* Removes a run, that becomes part of the gap
+*****************************************************************/
+void removeRun(tm_tape * t, int slot) {
+	moveGap(t, slot);
+	t->writesNum--;
 }
 
-/*****************************************************************
- * Frees the Turing Machine graph
- *****************************************************************/
+/****************************************************************
+* Adds to *hash and *check the hashes of the cells from first to
+* last of a tape stored as runs. Each run takes a constant time,
+* whatever its length (see hashRun).
+*****************************************************************/
+void hashRuns(tm_tape * t, int first, int last, unsigned long * hash, unsigned long * check) {
+	for (int i = (first == INT_MIN) ? 0 : findRun(t, first); i < t->writesNum; i++) {
+		int r = runSlot(t, i);
+		if (t->positions[r] > last)
+			break;
+		int from = (t->positions[r] > first) ? t->positions[r] : first;
+		int to = t->positions[r] + t->lengths[r] - 1;
+		if (to > last)
+			to = last;
+		*hash += hashRun(from, to, t->symbols[r], FNV_OFFSET, inputHashSums);
+		*check += hashRun(from, to, t->symbols[r], ~FNV_OFFSET, inputCheckSums);
+	}
+}
+
+/****************************************************************
+* Returns the hash of the cells from first to last, that hold the
+* symbol c: the sum over the cells of the difference between the
+* weight of c and that of the input symbol, times the weight of
+* the cell. The weight of a cell is the difference of positionSum
+* at its two sides, so that the weights of the cells from first to
+* last add up to positionSum(last + 1) - positionSum(first); the
+* input symbols add up in the same way with inputSums, computed by
+* sumInputWeights for the input string.
+*****************************************************************/
+unsigned long hashRun(int first, int last, char c, unsigned long seed, unsigned long * inputSums) {
+	unsigned long blank = symbolWeight(BLANK, seed);
+	unsigned long h = (symbolWeight(c, seed) - blank) * (positionSum(last + 1, seed) - positionSum(first, seed));
+
+	int from = (first > 0) ? first : 0;				// the cells of the input string, the others are BLANK
+	int to = (last < inputLength - 1) ? last : inputLength - 1;
+	if (from <= to)
+		h -= inputSums[to + 1] - inputSums[from];
+	return h;
+}
+
+/****************************************************************
+* Computes the sums of the weights of the cells of the input string
+* (see hashRun), relative to BLANK: inputHashSums[i] is the sum of
+* the cells before i
+*****************************************************************/
+void sumInputWeights() {
+	inputHashSums = (unsigned long *) realloc(inputHashSums, 2 * (inputLength + 1) * sizeof(unsigned long));
+	inputCheckSums = &inputHashSums[inputLength + 1];
+	inputHashSums[0] = 0;
+	inputCheckSums[0] = 0;
+	for (int i = 0; i < inputLength; i++) {
+		inputHashSums[i+1] = inputHashSums[i] + (symbolWeight(inputString[i], FNV_OFFSET) - symbolWeight(BLANK, FNV_OFFSET))
+			* (positionSum(i + 1, FNV_OFFSET) - positionSum(i, FNV_OFFSET));
+		inputCheckSums[i+1] = inputCheckSums[i] + (symbolWeight(inputString[i], ~FNV_OFFSET) - symbolWeight(BLANK, ~FNV_OFFSET))
+			* (positionSum(i + 1, ~FNV_OFFSET) - positionSum(i, ~FNV_OFFSET));
+	}
+}
+
+/****************************************************************
+* Gives the tape back to the spare tapes: its header is reused by
+* the next copy, only the written cells go back to malloc
+*****************************************************************/
+void freeTape(tm_tape * t) {
+	free(t->positions);
+	t->next = spareTapes;
+	spareTapes = t;
+}
+
+/****************************************************************
+* Returns a tape without written cells
+*****************************************************************/
+tm_tape * newTape() {
+	tm_tape * t = spareTapes;
+	if (t == NULL)
+		t = (tm_tape *) malloc(sizeof(tm_tape));
+	else spareTapes = t->next;
+	memset(t, 0, sizeof(tm_tape));
+	return t;
+}
+
+/****************************************************************
+* Returns a transition for a queue: the transitions removed from
+* the queues are reused, new ones are allocated RECORDS_SLAB_DIM
+* at a time (and never given back, like the tape headers: they are
+* as many as the widest level)
+*****************************************************************/
+transition * newTransition() {
+	if (spareTransitions == NULL) {
+		transition * slab = (transition *) malloc(RECORDS_SLAB_DIM * sizeof(transition));
+		for (int i = 0; i < RECORDS_SLAB_DIM; i++) {
+			slab[i].next = spareTransitions;
+			spareTransitions = &slab[i];
+		}
+	}
+	transition * t = spareTransitions;
+	spareTransitions = t->next;
+	return t;
+}
+
+//****************************************************************
+void releaseTransition(transition * t) {
+	t->next = spareTransitions;
+	spareTransitions = t;
+}
+
+/****************************************************************
+* Puts a new element in the queue passed as parameter
+*****************************************************************/
+void putInQueue(transition ** queue, transition ** tail, int state, graph_node * p, tm_tape * tape, int index, path_step * parent) {
+
+	transition * new = newTransition();
+
+	new->state = state;
+	new->in = p->in;
+	new->out = p->out;
+	new->move = p->move;
+	new->next_state = p->next_state;
+	new->index = index;
+	new->tape = tape;
+	new->parent = parent;
+	if (parent != NULL)
+		parent->refs++;
+	if (new->tape->pointers_num == 0)
+		frontierBytes += sizeof(tm_tape) + tape->writesDim * slotBytes;
+	new->tape->pointers_num++;
+	frontierBytes += sizeof(transition);
+
+	if (*queue == NULL) {
+		*queue = new;
+	}
+
+	if (*tail != NULL)
+		(*tail)->next = new;
+
+	new->next = NULL;
+	*tail = new;
+}
+
+/****************************************************************
+* Removes the first element of the queue passed as parameter
+*****************************************************************/
+void removeFromQueue(transition ** queue, transition ** tail) {
+
+	if (queue == NULL)
+		return;
+
+	transition * toBeRemoved = *queue;
+	*queue = (*queue)->next;
+
+	if (toBeRemoved == *tail)
+		*tail = NULL;
+
+	toBeRemoved->next = NULL;
+
+	if (DEBUG) printf("removed : %d %c %c %d %d %d\n", toBeRemoved->state, toBeRemoved->in, toBeRemoved->out, toBeRemoved->move, toBeRemoved->next_state, toBeRemoved->index);
+
+	toBeRemoved->tape->pointers_num--;
+
+	if (toBeRemoved->tape->pointers_num == 0) {
+		frontierBytes -= sizeof(tm_tape) + toBeRemoved->tape->writesDim * slotBytes;
+		freeTape(toBeRemoved->tape);
+	}
+	if (toBeRemoved->parent != NULL)
+		releaseStep(toBeRemoved->parent);
+
+	frontierBytes -= sizeof(transition);
+	releaseTransition(toBeRemoved);
+}
+
+/*****************************************************************
+ * Moves the given queue (part of the next level) to the end of
+ * the next level spill file, releasing its memory. Each record
+ * holds the transition, the head index and the written cells.
+ *****************************************************************/
+void spillQueue(transition ** queue, transition ** tail) {
+	if (nextLevelSpill == NULL) {
+		levelSpill = tmpfile();
+		nextLevelSpill = tmpfile();
+		if (levelSpill == NULL || nextLevelSpill == NULL) {
+			printf("Error: can't create spill files...");
+			exit(0);
+		}
+		setvbuf(levelSpill, NULL, _IOFBF, SPILL_BUFFER_DIM);
+		setvbuf(nextLevelSpill, NULL, _IOFBF, SPILL_BUFFER_DIM);
+	}
+
+	while (*queue != NULL) {
+		transition * t = *queue;
+		signed char fields[3] = {t->in, t->out, (signed char) t->move};
+		fwrite(&t->state, sizeof(int), 1, nextLevelSpill);
+		fwrite(fields, 1, 3, nextLevelSpill);
+		fwrite(&t->next_state, sizeof(int), 1, nextLevelSpill);
+		fwrite(&t->index, sizeof(int), 1, nextLevelSpill);
+		if (tapeRuns == true)		// the runs are written in order, the gap is moved after them
+			moveGap(t->tape, t->tape->writesNum);
+		fwrite(&t->tape->writesNum, sizeof(int), 1, nextLevelSpill);
+		fwrite(t->tape->positions, sizeof(int), t->tape->writesNum, nextLevelSpill);
+		if (tapeRuns == true)
+			fwrite(t->tape->lengths, sizeof(int), t->tape->writesNum, nextLevelSpill);
+		fwrite(t->tape->symbols, 1, t->tape->writesNum, nextLevelSpill);
+		if (witnessFile != NULL) {		// the steps stay in memory, the record keeps the reference
+			fwrite(&t->parent, sizeof(path_step *), 1, nextLevelSpill);
+			t->parent = NULL;
+		}
+		nextLevelSpilledNum++;
+		removeFromQueue(queue, tail);
+	}
+
+	if (DEBUG) printf("SPILL: %ld transitions on disk\n", nextLevelSpilledNum);
+}
+
+/*****************************************************************
+ * Reads back the next transition of the current level spill file
+ *****************************************************************/
+transition * readSpilledTransition() {
+	transition * t = newTransition();
+	tm_tape * spilledTape = newTape();
+	signed char fields[3];
+
+	fread(&t->state, sizeof(int), 1, levelSpill);
+	fread(fields, 1, 3, levelSpill);
+	fread(&t->next_state, sizeof(int), 1, levelSpill);
+	fread(&t->index, sizeof(int), 1, levelSpill);
+	fread(&spilledTape->writesNum, sizeof(int), 1, levelSpill);
+	spilledTape->writesDim = spilledTape->writesNum;
+	spilledTape->cursor = 0;
+	setSlots(spilledTape, (int *) malloc(spilledTape->writesNum * slotBytes), spilledTape->writesNum);
+	fread(spilledTape->positions, sizeof(int), spilledTape->writesNum, levelSpill);
+	if (tapeRuns == true)
+		fread(spilledTape->lengths, sizeof(int), spilledTape->writesNum, levelSpill);
+	fread(spilledTape->symbols, 1, spilledTape->writesNum, levelSpill);
+	t->parent = NULL;
+	if (witnessFile != NULL)
+		fread(&t->parent, sizeof(path_step *), 1, levelSpill);
+	spilledTape->pointers_num = 1;
+	spilledTape->cellsHash = 0;
+	spilledTape->cellsCheck = 0;
+	if (tapeRuns == true)
+		hashRuns(spilledTape, INT_MIN, INT_MAX, &spilledTape->cellsHash, &spilledTape->cellsCheck);
+	else for (int i = 0; i < spilledTape->writesNum; i++) {
+		spilledTape->cellsHash += hashCell(spilledTape->positions[i], spilledTape->symbols[i], FNV_OFFSET);
+		spilledTape->cellsCheck += hashCell(spilledTape->positions[i], spilledTape->symbols[i], ~FNV_OFFSET);
+	}
+	t->in = fields[0];
+	t->out = fields[1];
+	t->move = fields[2];
+	t->tape = spilledTape;
+	levelSpilledNum--;
+
+	frontierBytes += sizeof(transition) + sizeof(tm_tape) + spilledTape->writesDim * slotBytes;
+	return t;
+}
+
+/*****************************************************************
+ * Empties the spill files at the end of a computation
+ *****************************************************************/
+void resetSpillFiles() {
+	levelSpilledNum = 0;
+	nextLevelSpilledNum = 0;
+	if (levelSpill != NULL) {
+		rewind(levelSpill);
+		ftruncate(fileno(levelSpill), 0);
+		rewind(nextLevelSpill);
+		ftruncate(fileno(nextLevelSpill), 0);
+	}
+}
+
+/*****************************************************************
+ * Marks the states from which an acceptation state is reachable,
+ * and computes how many transitions away the nearest one is
+ *****************************************************************/
+void computeAcceptingStates() {
+	bool changed = true;
+
+	for (int i = 0; i < states_num; i++)
+		graph[i].acceptDistance = (graph[i].isAccState == true) ? 0 : NO_DISTANCE;
+
+	while (changed == true) {
+		changed = false;
+		for (int i = 0; i < states_num; i++) {
+			if (graph[i].acceptDistance == 0 || graph[i].transitions == NULL)
+				continue;
+			for (int j = 0; j < POSSIBLE_CHARS_NUM; j++) {
+				for (graph_node * p = graph[i].transitions[j]; p != NULL; p = p->next) {
+					int d = graph[p->next_state].acceptDistance;
+					if (d != NO_DISTANCE && d + 1 < graph[i].acceptDistance) {
+						graph[i].acceptDistance = d + 1;
+						changed = true;
+					}
+				}
+			}
+		}
+	}
+
+	for (int i = 0; i < states_num; i++)
+		graph[i].canAccept = (graph[i].acceptDistance != NO_DISTANCE) ? true : false;
+}
+
+/*****************************************************************
+ * Merges the equivalent states of the machine and renumbers them
+ * densely, keeping the starting state as 0. The states are split
+ * by partition refinement: two states stay in the same class while
+ * they have the same kind (non-accepting, accepting or accepting
+ * starting state) and, for each read symbol, the same set of
+ * (written symbol, move, class of the target) transitions.
+ * Transitions out of an accepting state are never followed (the
+ * string is accepted on entering it), so they are ignored unless
+ * the state is the starting one. Transitions that become identical
+ * after the merge are removed.
+ *****************************************************************/
+void minimizeMachine() {
+	int n = states_num;
+	int * classOf = (int *) calloc(n, sizeof(int));
+	int * newClassOf = (int *) malloc(n * sizeof(int));
+	int * order = (int *) malloc(n * sizeof(int));
+	int * representative = (int *) malloc(n * sizeof(int));
+	int classesNum = 1;
+	int prevClassesNum = 0;
+
+	int sigDim = 0;			// 3 fields plus 4 for each followed transition
+	for (int i = 0; i < n; i++) {
+		sigDim += 3;
+		if (graph[i].transitions == NULL)
+			continue;
+		for (int j = 0; j < POSSIBLE_CHARS_NUM; j++)
+			for (graph_node * p = graph[i].transitions[j]; p != NULL; p = p->next)
+				sigDim += 4;
+	}
+	signatures = (int *) malloc(sigDim * sizeof(int));
+	signatureStart = (int *) malloc(n * sizeof(int));
+
+	while (classesNum != prevClassesNum) {
+		int k = 0;
+		for (int i = 0; i < n; i++) {
+			int * sig = &signatures[k];
+			signatureStart[i] = k;
+			sig[0] = classOf[i];
+			sig[1] = (graph[i].isAccState == false) ? 0 : (i == startingState) ? 2 : 1;
+			sig[2] = 0;
+			k += 3;
+			if (graph[i].transitions == NULL || sig[1] == 1)
+				continue;
+			for (int j = 0; j < POSSIBLE_CHARS_NUM; j++) {
+				for (graph_node * p = graph[i].transitions[j]; p != NULL; p = p->next) {
+					signatures[k++] = j;
+					signatures[k++] = p->out;
+					signatures[k++] = p->move;
+					signatures[k++] = classOf[p->next_state];
+					sig[2]++;
+				}
+			}
+			qsort(&sig[3], sig[2], 4 * sizeof(int), compareTuples);
+		}
+
+		for (int i = 0; i < n; i++)
+			order[i] = i;
+		qsort(order, n, sizeof(int), compareSignatures);
+
+		// classes are numbered by their lowest state, so that the starting state stays in class 0
+		prevClassesNum = classesNum;
+		classesNum = 0;
+		for (int i = 0; i < n; i++)
+			newClassOf[i] = -1;
+		for (int i = 0; i < n; i++) {
+			if (newClassOf[i] != -1)
+				continue;
+			int lo = 0, hi = n - 1;		// the equal signatures are contiguous in order, find them
+			while (lo < hi) {
+				int mid = (lo + hi) / 2;
+				if (compareSignatures(&order[mid], &i) < 0)
+					lo = mid + 1;
+				else hi = mid;
+			}
+			for (; lo < n && compareSignatures(&order[lo], &i) == 0; lo++)
+				newClassOf[order[lo]] = classesNum;
+			representative[classesNum++] = i;
+		}
+		int * swap = classOf;
+		classOf = newClassOf;
+		newClassOf = swap;
+	}
+
+	if (DEBUG) printf("\nMinimization: %d states -> %d\n", n, classesNum);
+
+	// each class takes the place of its representative, which comes at or after it
+	for (int i = 0; i < n; i++) {
+		if (representative[classOf[i]] != i) {
+			freeTransitions(graph[i].transitions);
+			graph[i].transitions = NULL;
+		}
+	}
+	for (int c = 0; c < classesNum; c++) {
+		graph[c] = graph[representative[c]];
+		stateIds[c] = stateIds[representative[c]];		// the class is shown as its representative
+		if (graph[c].isAccState == true && c != startingState) {
+			freeTransitions(graph[c].transitions);
+			graph[c].transitions = NULL;
+		}
+		if (graph[c].transitions == NULL)
+			continue;
+		for (int j = 0; j < POSSIBLE_CHARS_NUM; j++) {
+			for (graph_node * p = graph[c].transitions[j]; p != NULL; p = p->next)
+				p->next_state = classOf[p->next_state];
+			for (graph_node * p = graph[c].transitions[j]; p != NULL; p = p->next) {
+				graph_node * q = p;			// remove the following copies of this transition
+				while (q->next != NULL) {
+					graph_node * r = q->next;
+					if (r->out == p->out && r->move == p->move && r->next_state == p->next_state) {
+						q->next = r->next;
+						free(r);
+					}
+					else q = r;
+				}
+			}
+		}
+	}
+	for (int i = classesNum; i < n; i++) {
+		graph[i].transitions = NULL;
+		graph[i].isAccState = false;
+		graph[i].canAccept = false;
+	}
+	states_num = classesNum;
+
+	free(signatures);
+	free(signatureStart);
+	free(classOf);
+	free(newClassOf);
+	free(order);
+	free(representative);
+}
+
+/*****************************************************************
+ * Orders the states by signature (used to group the states with
+ * the same signature)
+ *****************************************************************/
+int compareSignatures(const void * a, const void * b) {
+	int * x = &signatures[signatureStart[*(const int *) a]];
+	int * y = &signatures[signatureStart[*(const int *) b]];
+	int length = 3 + 4 * x[2];
+
+	if (x[2] != y[2])
+		return (x[2] < y[2]) ? -1 : 1;
+	for (int i = 0; i < length; i++)
+		if (x[i] != y[i])
+			return (x[i] < y[i]) ? -1 : 1;
+	return 0;
+}
+
+/*****************************************************************
+ * Orders the (read, written, move, target class) tuples of a
+ * signature, so that the order of the transitions doesn't matter
+ *****************************************************************/
+int compareTuples(const void * a, const void * b) {
+	const int * x = (const int *) a;
+	const int * y = (const int *) b;
+	for (int i = 0; i < 4; i++)
+		if (x[i] != y[i])
+			return (x[i] < y[i]) ? -1 : 1;
+	return 0;
+}
+
+/*****************************************************************
+ * Frees a transitions table of a state
+ *****************************************************************/
+void freeTransitions(graph_node ** transitions) {
+	if (transitions == NULL)
+		return;
+	for (int j = 0; j < POSSIBLE_CHARS_NUM; j++) {
+		graph_node * p = transitions[j];
+		while (p != NULL) {
+			graph_node * next = p->next;
+			free(p);
+			p = next;
+		}
+	}
+	free(transitions);
+}
+
+/*****************************************************************
+ * Marks the states from which a LEFT (RIGHT) move is reachable:
+ * from the other states the head never goes back to the cells on
+ * its left (right)
+ *****************************************************************/
+void computeMoveDirections() {
+	bool changed = true;
+
+	for (int i = 0; i < states_num; i++) {
+		graph[i].canMoveLeft = false;
+		graph[i].canMoveRight = false;
+		if (graph[i].transitions == NULL)
+			continue;
+		for (int j = 0; j < POSSIBLE_CHARS_NUM; j++) {
+			for (graph_node * p = graph[i].transitions[j]; p != NULL; p = p->next) {
+				if (p->move == LEFT)
+					graph[i].canMoveLeft = true;
+				else if (p->move == RIGHT)
+					graph[i].canMoveRight = true;
+			}
+		}
+	}
+
+	while (changed == true) {
+		changed = false;
+		for (int i = 0; i < states_num; i++) {
+			if (graph[i].transitions == NULL)
+				continue;
+			for (int j = 0; j < POSSIBLE_CHARS_NUM; j++) {
+				for (graph_node * p = graph[i].transitions[j]; p != NULL; p = p->next) {
+					if (graph[p->next_state].canMoveLeft == true && graph[i].canMoveLeft == false) {
+						graph[i].canMoveLeft = true;
+						changed = true;
+					}
+					if (graph[p->next_state].canMoveRight == true && graph[i].canMoveRight == false) {
+						graph[i].canMoveRight = true;
+						changed = true;
+					}
+				}
+			}
+		}
+	}
+}
+
+/*****************************************************************
+ * Returns true if the configuration (state, tape, head) has
+ * already been reached in the current level, otherwise adds it to
+ * the set. Configurations are compared only on the cells the head
+ * can still read: those on its left are trimmed if the state can't
+ * move left, those on its right if it can't move right. Narrow
+ * levels are never checked, and a string stops being checked as
+ * soon as SEEN_SAMPLE_DIM checks find less than one duplicate
+ * every SEEN_HIT_RATIO (the check costs more than it saves).
+ *****************************************************************/
+bool isDuplicate(int state, tm_tape * t, int index) {
+	if (pruneDuplicates == false || pruneString == false || levelWidth < SEEN_MIN_WIDTH)
+		return false;
+
+	if (++seenChecks == SEEN_SAMPLE_DIM) {
+		if (seenHits * SEEN_HIT_RATIO < seenChecks)
+			pruneString = false;
+		seenChecks = 0;
+		seenHits = 0;
+		if (pruneString == false)
+			return false;
+	}
+
+	unsigned long cellsHash = 0, cellsCheck = 0;
+	int slot = (tapeRuns == true) ? 0 : findCell(t, index);
+	int first = (graph[state].canMoveLeft == true) ? 0 : slot;
+	int last = t->writesNum;
+	if (graph[state].canMoveRight == false && tapeRuns == false)
+		last = (slot < t->writesNum && t->positions[slot] == index) ? slot + 1 : slot;
+
+	// the sums of the trimmed cells are computed from the fewest cells: the kept ones or the others
+	if (tapeRuns == true) {
+		if (graph[state].canMoveLeft == true && graph[state].canMoveRight == true) {
+			cellsHash = t->cellsHash;
+			cellsCheck = t->cellsCheck;
+		}
+		else hashRuns(t, (graph[state].canMoveLeft == true) ? INT_MIN : index,
+					  (graph[state].canMoveRight == true) ? INT_MAX : index, &cellsHash, &cellsCheck);
+	}
+	else if (2 * (last - first) <= t->writesNum) {
+		for (int i = first; i < last; i++) {
+			cellsHash += hashCell(t->positions[i], t->symbols[i], FNV_OFFSET);
+			cellsCheck += hashCell(t->positions[i], t->symbols[i], ~FNV_OFFSET);
+		}
+	}
+	else {
+		cellsHash = t->cellsHash;
+		cellsCheck = t->cellsCheck;
+		for (int i = 0; i < first; i++) {
+			cellsHash -= hashCell(t->positions[i], t->symbols[i], FNV_OFFSET);
+			cellsCheck -= hashCell(t->positions[i], t->symbols[i], ~FNV_OFFSET);
+		}
+		for (int i = last; i < t->writesNum; i++) {
+			cellsHash -= hashCell(t->positions[i], t->symbols[i], FNV_OFFSET);
+			cellsCheck -= hashCell(t->positions[i], t->symbols[i], ~FNV_OFFSET);
+		}
+	}
+
+	// the length of the path is part of the configuration: the best-first search mixes them in the set
+	unsigned long head = ((unsigned long) (unsigned int) state << 32) | (unsigned int) index;
+	unsigned long hash = mixHash(cellsHash + mixHash((head ^ FNV_OFFSET) + currIteration * FNV_PRIME));
+	unsigned long check = mixHash(cellsCheck + mixHash((head ^ ~FNV_OFFSET) + currIteration * FNV_PRIME));
+
+	if (2 * (seenNum + 1) > seenDim) {		// keep the set at most half full
+		unsigned long oldDim = seenDim;
+		seen_slot * old = seenSlots;
+		seenDim = (seenDim == 0) ? SEEN_DEFAULT_DIM : 2 * seenDim;
+		seenSlots = (seen_slot *) calloc(seenDim, sizeof(seen_slot));
+		for (unsigned long i = 0; i < oldDim; i++) {
+			if (old[i].epoch != seenEpoch)
+				continue;
+			unsigned long h = old[i].hash & (seenDim - 1);
+			while (seenSlots[h].epoch == seenEpoch)
+				h = (h + 1) & (seenDim - 1);
+			seenSlots[h] = old[i];
+		}
+		free(old);
+	}
+
+	unsigned long h = hash & (seenDim - 1);
+	while (seenSlots[h].epoch == seenEpoch) {
+		if (seenSlots[h].hash == hash && seenSlots[h].check == check) {
+			seenHits++;
+			return true;
+		}
+		h = (h + 1) & (seenDim - 1);
+	}
+	seenSlots[h].hash = hash;
+	seenSlots[h].check = check;
+	seenSlots[h].epoch = seenEpoch;
+	seenNum++;
+	return false;
+}
+
+/*****************************************************************
+ * Hash of a written cell: the hash of a tape is the sum of those
+ * of its cells, so that it is updated at each write
+ *****************************************************************/
+static inline unsigned long hashCell(int position, char symbol, unsigned long seed) {
+	return mixHash((((unsigned long) (unsigned int) position << 8) | (unsigned char) symbol) ^ seed);
+}
+
+/*****************************************************************
+ * With -R, the cells are weighted by differences of this function,
+ * so that the weights of consecutive cells add up in constant time
+ *****************************************************************/
+static inline unsigned long positionSum(int position, unsigned long seed) {
+	return mixHash((unsigned long) (unsigned int) position ^ seed);
+}
+
+/*****************************************************************
+ * With -R, the weight of a symbol in the hashes of the runs
+ *****************************************************************/
+static inline unsigned long symbolWeight(char symbol, unsigned long seed) {
+	return mixHash(((unsigned long) (unsigned char) symbol << 32) ^ ~seed);
+}
+
+/*****************************************************************
+ * Scrambles the bits of a word (finalizer of splitmix64)
+ *****************************************************************/
+static inline unsigned long mixHash(unsigned long x) {
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9UL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebUL;
+	return x ^ (x >> 31);
+}
+
+/*****************************************************************
+ * Returns a new step, the given choice made after the parent one,
+ * taken from the arena: the unreachable steps are reused first,
+ * then the slabs are filled in order
+ *****************************************************************/
+path_step * newStep(path_step * parent, graph_node * choice) {
+	path_step * step = freeSteps;
+	if (step != NULL)
+		freeSteps = step->parent;
+	else {
+		if (stepSlabUsed == STEPS_SLAB_DIM) {
+			stepSlab++;
+			stepSlabUsed = 0;
+		}
+		if (stepSlab == stepSlabsNum) {
+			if (stepSlabsNum == stepSlabsDim) {
+				stepSlabsDim = (stepSlabsDim == 0) ? DEFAULT_STATES_DIM : 2 * stepSlabsDim;
+				stepSlabs = (path_step **) realloc(stepSlabs, stepSlabsDim * sizeof(path_step *));
+			}
+			stepSlabs[stepSlabsNum++] = (path_step *) malloc(STEPS_SLAB_DIM * sizeof(path_step));
+		}
+		step = &stepSlabs[stepSlab][stepSlabUsed++];
+	}
+
+	step->parent = parent;
+	step->choice = choice;
+	step->refs = 0;
+	if (parent != NULL)
+		parent->refs++;
+	return step;
+}
+
+/*****************************************************************
+ * Drops a reference to the given step: a step no longer reachable
+ * goes back to the arena, and so does its parent if it was the
+ * last reference to it (the link to the parent becomes the link
+ * of the list of free steps)
+ *****************************************************************/
+void releaseStep(path_step * step) {
+	while (step != NULL && --step->refs == 0) {
+		path_step * parent = step->parent;
+		step->parent = freeSteps;
+		freeSteps = step;
+		step = parent;
+	}
+}
+
+/*****************************************************************
+ * Gives back all the steps at the end of a computation, so that
+ * the references of the unread spilled transitions don't matter
+ *****************************************************************/
+void resetSteps() {
+	stepSlab = 0;
+	stepSlabUsed = 0;
+	freeSteps = NULL;
+}
+
+/*****************************************************************
+ * Writes the accepting path ending with the given transition: the
+ * number of the string, then its transitions in the input format
+ * of the machine, in order, and an empty line. The path is run
+ * again from the start, taking the saved choice wherever more
+ * than one transition is possible; it has currIteration steps.
+ *****************************************************************/
+void writeWitness(transition * t) {
+	int choicesNum = 0;
+	for (path_step * step = t->parent; step != NULL; step = step->parent) {
+		if (choicesNum == witnessDim) {
+			witnessDim = (witnessDim == 0) ? DEFAULT_INPUT_DIM : 2 * witnessDim;
+			witnessSteps = (path_step **) realloc(witnessSteps, witnessDim * sizeof(path_step *));
+		}
+		witnessSteps[choicesNum++] = step;
+	}
+
+	if (witnessTapeDim < inputLength + 2 * DEFAULT_PADDING_DIM) {
+		witnessTapeDim = inputLength + 2 * DEFAULT_PADDING_DIM;
+		witnessTape = (char *) realloc(witnessTape, witnessTapeDim);
+	}
+	int head = (witnessTapeDim - inputLength) / 2;		// the tape grown by the previous strings is shared by both sides
+	memset(witnessTape, BLANK, witnessTapeDim);
+	memcpy(&witnessTape[head], inputString, inputLength);
+	int s = startingState;
+
+	fprintf(witnessFile, "string %d\n", stringsNum);
+	for (long int i = 0; i < currIteration; i++) {
+		graph_node * p = graph[s].transitions[(unsigned char) witnessTape[head]];
+		if (p->next != NULL)
+			p = witnessSteps[--choicesNum]->choice;
+		fprintf(witnessFile, "%ld %c %c %c %ld\n", stateIds[s], p->in, p->out, "LSR"[p->move + 1], stateIds[p->next_state]);
+
+		witnessTape[head] = p->out;
+		head += p->move;
+		s = p->next_state;
+		if (head == witnessTapeDim) {		// grow the tape on the right
+			witnessTape = (char *) realloc(witnessTape, 2 * witnessTapeDim);
+			memset(&witnessTape[witnessTapeDim], BLANK, witnessTapeDim);
+			witnessTapeDim *= 2;
+		}
+		else if (head < 0) {				// grow the tape on the left
+			witnessTape = (char *) realloc(witnessTape, 2 * witnessTapeDim);
+			memmove(&witnessTape[witnessTapeDim], witnessTape, witnessTapeDim);
+			memset(witnessTape, BLANK, witnessTapeDim);
+			head += witnessTapeDim;
+			witnessTapeDim *= 2;
+		}
+	}
+	fprintf(witnessFile, "\n");
+}
+
+/*****************************************************************
+ * Empties the set of the configurations of the level
+ *****************************************************************/
+void clearSeen() {
+	seenEpoch++;
+	seenNum = 0;
+}
+
+/*****************************************************************
+ * Checks the duplicates of a new string, whatever the rate of the
+ * previous one
+ *****************************************************************/
+void resetPruning() {
+	pruneString = true;
+	seenChecks = 0;
+	seenHits = 0;
+}
+
+/*****************************************************************
+ * Decides if the path of the given transition has to be followed:
+ * once the result is UNDEFINED, paths that can't reach an
+ * acceptation state can't change it anymore; paths that provably
+ * loop forever make it UNDEFINED without being followed
+ *****************************************************************/
+bool followPath(transition * t) {
+	if (atLeastAnUndefinedPath == true && graph[t->next_state].canAccept == false)
+		return false;
+
+	if (t->state != t->next_state)
+		return true;
+
+	if (t->in == t->out && t->move == STOP) {	// same configuration again and again
+		atLeastAnUndefinedPath = true;
+		return false;
+	}
+
+	// the only transition on BLANK, moving towards a region that contains only BLANK characters
+	if (t->in != BLANK || graph[t->state].transitions[BLANK]->next != NULL || t->move == STOP)
+		return true;
+	tm_tape * tp = t->tape;
+	if (t->move == RIGHT) {
+		int lastSlot = (tapeRuns == true) ? runSlot(tp, tp->writesNum-1) : tp->writesNum-1;
+		int written = (tp->writesNum == 0) ? -1 : tp->positions[lastSlot] + ((tapeRuns == true) ? tp->lengths[lastSlot] - 1 : 0);
+		int last = (written >= inputLength) ? written : inputLength-1;
+		for (int i = t->index + 1; i <= last; i++)
+			if (readTape(tp, i) != BLANK)
+				return true;
+	}
+	else {
+		int firstSlot = (tapeRuns == true) ? runSlot(tp, 0) : 0;
+		int first = (tp->writesNum != 0 && tp->positions[firstSlot] < 0) ? tp->positions[firstSlot] : 0;
+		for (int i = t->index - 1; i >= first; i--)
+			if (readTape(tp, i) != BLANK)
+				return true;
+	}
+	atLeastAnUndefinedPath = true;
+	return false;
+}
+
+/*****************************************************************
+ * Returns true if the current string exceeded one of its budgets
+ *****************************************************************/
+bool checkBudget() {
+	if (stepsBudget != 0 && stepsNum > stepsBudget)
+		budgetExceeded = BUDGET_STEPS;
+	else if (stepsNum % BUDGET_CHECK_PERIOD == 0) {
+		if (progressRequested != 0)
+			reportProgress();
+		if (timeBudget != 0) {
+			struct timespec now;
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			if ((now.tv_sec - startTime.tv_sec) * 1000 + (now.tv_nsec - startTime.tv_nsec) / 1000000 > timeBudget)
+				budgetExceeded = BUDGET_TIME;
+		}
+	}
+	return (budgetExceeded != BUDGET_NONE) ? true : false;
+}
+
+/*****************************************************************
+ * Called by the native code of the machine every
+ * BUDGET_CHECK_PERIOD steps (when there is a time budget): returns
+ * 1 if the time budget of the string has been exceeded
+ *****************************************************************/
+int checkJitTime() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if ((now.tv_sec - startTime.tv_sec) * 1000 + (now.tv_nsec - startTime.tv_nsec) / 1000000 > timeBudget) {
+		budgetExceeded = BUDGET_TIME;
+		return 1;
+	}
+	return 0;
+}
+
+/*****************************************************************
+ * Signal handler: asks for a progress report, which is written by
+ * the computation itself at its next check (only a flag is set
+ * here, and the heartbeat alarm is armed again)
+ *****************************************************************/
+void requestProgress(int sig) {
+	progressRequested = 1;
+	if (sig == SIGALRM)
+		alarm(progressPeriod);
+}
+
+/*****************************************************************
+ * Writes on stderr how far the current string is: its level out of
+ * max, the transitions of the current and of the next level (and
+ * the spilled ones), the memory of the queued transitions and of
+ * their tapes, and the steps per second since the last report (or
+ * since the string started)
+ *****************************************************************/
+void reportProgress() {
+	struct timespec now;
+	struct timespec since = reportTime;
+	long int steps = stepsNum - reportSteps;
+
+	progressRequested = 0;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (reportString != stringsNum || steps < 0) {		// first report of this string
+		since = startTime;
+		steps = stepsNum;
+	}
+	double seconds = (now.tv_sec - since.tv_sec) + (now.tv_nsec - since.tv_nsec) / 1e9;
+
+	if (batchMode == true)
+		fprintf(stderr, "batch: ");
+	else fprintf(stderr, "string %d: ", stringsNum);
+	if (heuristic != BEST_FIRST_NONE)		// no levels: currIteration is the length of the path being followed
+		fprintf(stderr, "path of %ld steps of %ld, %ld transitions in the frontier, %ld bytes of frontier, %.0f steps/s\n",
+				currIteration, iterationsLimit, frontierNum, frontierBytes, (seconds > 0) ? steps / seconds : 0);
+	else fprintf(stderr, "iteration %ld of %ld (%.1f%%), %ld transitions in the level, %ld in the next, %ld spilled, %ld bytes of frontier, %.0f steps/s\n",
+			currIteration, iterationsLimit, 100.0 * currIteration / iterationsLimit, levelWidth, nextLevelWidth,
+			levelSpilledNum + nextLevelSpilledNum, frontierBytes, (seconds > 0) ? steps / seconds : 0);
+
+	reportString = stringsNum;
+	reportSteps = stepsNum;
+	reportTime = now;
+}
+
+/*****************************************************************
+ * Adds n bytes to a FNV-1a hash
+ *****************************************************************/
+unsigned long hashBytes(unsigned long h, const void * bytes, size_t n) {
+	for (size_t k = 0; k < n; k++) {
+		h ^= ((const unsigned char *) bytes)[k];
+		h *= FNV_PRIME;
+	}
+	return h;
+}
+
+/*****************************************************************
+ * Computes a FNV-1a hash of the machine (transitions and
+ * acceptation states), used to name its cached native code
+ *****************************************************************/
+unsigned long hashMachine() {
+	unsigned long h = FNV_OFFSET;
+	long int fields[5];
+
+	#define HASH_FIELDS(n) h = hashBytes(h, fields, (n) * sizeof(long int))
+
+	fields[0] = JIT_ABI_VERSION;
+	fields[1] = states_num;
+	HASH_FIELDS(2);
+	for (int i = 0; i < states_num; i++) {
+		fields[0] = i;
+		fields[1] = (graph[i].isAccState == true);
+		HASH_FIELDS(2);
+		if (graph[i].transitions == NULL)
+			continue;
+		for (int j = 0; j < POSSIBLE_CHARS_NUM; j++) {
+			for (graph_node * p = graph[i].transitions[j]; p != NULL; p = p->next) {
+				fields[0] = p->in;
+				fields[1] = p->out;
+				fields[2] = p->move;
+				fields[3] = p->next_state;
+				fields[4] = -1;
+				HASH_FIELDS(5);
+			}
+		}
+	}
+
+	#undef HASH_FIELDS
+	return h;
+}
+
+/*****************************************************************
+ * Prepares the results cache: results are keyed by the machine
+ * fingerprint (transitions, acceptation states and max) and by
+ * the input string, so changing any of them never reuses them
+ *****************************************************************/
+void initCache() {
+	long int fields[2] = { iterationsLimit, startingState };
+	machineFingerprint = hashBytes(hashMachine(), fields, sizeof(fields));
+
+	if (cacheCapacity <= 0)
+		return;
+	cacheBucketsNum = 1;
+	while (cacheBucketsNum < 2 * (unsigned long) cacheCapacity)
+		cacheBucketsNum *= 2;
+	cacheBuckets = (cache_entry **) calloc(cacheBucketsNum, sizeof(cache_entry *));
+}
+
+/*****************************************************************
+ * Maps the on-disk cache file in memory, creating it if missing.
+ * A file written for a different machine (or with a different
+ * max) is emptied. If the file cannot be used, only the in-memory
+ * cache is kept.
+ *****************************************************************/
+void openCacheFile(const char * path) {
+	size_t size = sizeof(cache_header) + (size_t) (CACHE_FILE_SLOTS) * sizeof(cache_slot);
+	struct stat st;
+
+	int fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		fprintf(stderr, "cannot open cache file %s, results will not be saved\n", path);
+		if (fd >= 0)
+			close(fd);
+		return;
+	}
+	if ((size_t) st.st_size != size && (ftruncate(fd, 0) != 0 || ftruncate(fd, size) != 0)) {
+		fprintf(stderr, "cannot resize cache file %s, results will not be saved\n", path);
+		close(fd);
+		return;
+	}
+
+	void * map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		fprintf(stderr, "cannot map cache file %s, results will not be saved\n", path);
+		return;
+	}
+	cacheFile = (cache_header *) map;
+	cacheSlots = (cache_slot *) (cacheFile + 1);
+
+	if (memcmp(cacheFile->magic, CACHE_MAGIC, sizeof(cacheFile->magic)) != 0
+			|| cacheFile->fingerprint != machineFingerprint || cacheFile->slotsNum != (CACHE_FILE_SLOTS)) {
+		if (DEBUG) printf("cache file %s belongs to another machine, emptying it\n", path);
+		memset(cacheSlots, 0, (size_t) (CACHE_FILE_SLOTS) * sizeof(cache_slot));
+		cacheFile->fingerprint = machineFingerprint;
+		cacheFile->slotsNum = CACHE_FILE_SLOTS;
+		memcpy(cacheFile->magic, CACHE_MAGIC, sizeof(cacheFile->magic));
+	}
+}
+
+/*****************************************************************
+ * Looks for the result of the current input string, first in
+ * memory and then on disk. Returns true (and the result) on a hit.
+ * Results needing more steps than the steps budget are ignored,
+ * since the budget would have stopped their computation.
+ *****************************************************************/
+bool lookupResult(char * result, int * length) {
+	*length = strlen(inputString);
+	stringHash = hashBytes(FNV_OFFSET, inputString, *length);
+	stringCheck = hashBytes(~FNV_OFFSET, inputString, *length);
+	if (stringHash == 0)
+		stringHash = 1;
+
+	if (cacheBuckets != NULL) {
+		cache_entry * e = cacheBuckets[stringHash & (cacheBucketsNum - 1)];
+		while (e != NULL && (e->hash != stringHash || strcmp(e->string, inputString) != 0))
+			e = e->nextInBucket;
+		if (e != NULL && (stepsBudget == 0 || e->steps <= stepsBudget)) {
+			if (e != cacheNewest) {		// move it to the front of the list
+				e->newer->older = e->older;
+				if (e->older != NULL)
+					e->older->newer = e->newer;
+				else cacheOldest = e->newer;
+				e->newer = NULL;
+				e->older = cacheNewest;
+				cacheNewest->newer = e;
+				cacheNewest = e;
+			}
+			*result = e->result;
+			return true;
+		}
+	}
+
+	if (cacheFile != NULL) {
+		for (int k = 0; k < CACHE_PROBES_NUM; k++) {
+			cache_slot * slot = &cacheSlots[(stringHash + k) & ((CACHE_FILE_SLOTS) - 1)];
+			if (slot->hash == 0)
+				break;
+			if (slot->hash == stringHash && slot->check == stringCheck && slot->length == *length) {
+				if (stepsBudget != 0 && slot->steps > stepsBudget)
+					break;
+				*result = slot->result;
+				stepsNum = slot->steps;
+				storeResult(*result, slot->steps);		// keep it in memory too
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+/*****************************************************************
+ * Saves the result of the current input string, evicting the
+ * least recently used one when the in-memory cache is full and
+ * overwriting a slot when its probe sequence on disk is full
+ *****************************************************************/
+void storeResult(char result, long int steps) {
+	int length = strlen(inputString);
+
+	if (cacheBuckets != NULL) {
+		cache_entry * e;
+		if (cacheEntriesNum == cacheCapacity) {		// evict the least recently used result
+			e = cacheOldest;
+			cacheOldest = e->newer;
+			if (cacheOldest != NULL)
+				cacheOldest->older = NULL;
+			else cacheNewest = NULL;
+			cache_entry ** p = &cacheBuckets[e->hash & (cacheBucketsNum - 1)];
+			while (*p != e)
+				p = &(*p)->nextInBucket;
+			*p = e->nextInBucket;
+			free(e->string);
+			cacheEntriesNum--;
+		}
+		else e = (cache_entry *) malloc(sizeof(cache_entry));
+
+		e->hash = stringHash;
+		e->string = (char *) malloc(length + 1);
+		memcpy(e->string, inputString, length + 1);
+		e->result = result;
+		e->steps = steps;
+		e->nextInBucket = cacheBuckets[stringHash & (cacheBucketsNum - 1)];
+		cacheBuckets[stringHash & (cacheBucketsNum - 1)] = e;
+		e->newer = NULL;
+		e->older = cacheNewest;
+		if (cacheNewest != NULL)
+			cacheNewest->newer = e;
+		else cacheOldest = e;
+		cacheNewest = e;
+		cacheEntriesNum++;
+	}
+
+	if (cacheFile != NULL) {
+		cache_slot * slot = &cacheSlots[stringHash & ((CACHE_FILE_SLOTS) - 1)];
+		for (int k = 0; k < CACHE_PROBES_NUM; k++) {
+			cache_slot * s = &cacheSlots[(stringHash + k) & ((CACHE_FILE_SLOTS) - 1)];
+			if (s->hash == 0 || (s->hash == stringHash && s->check == stringCheck && s->length == length)) {
+				slot = s;
+				break;
+			}
+		}
+		slot->hash = 0;		// written last, so a half written slot is never matched
+		slot->check = stringCheck;
+		slot->steps = steps;
+		slot->length = length;
+		slot->result = result;
+		slot->hash = stringHash;
+	}
+}
+
+/*****************************************************************
+ * Returns true if every (state, character) pair has at most one
+ * outgoing transition
+ *****************************************************************/
+bool isDeterministic() {
+	for (int i = 0; i < states_num; i++) {
+		if (graph[i].transitions == NULL)
+			continue;
+		for (int j = 0; j < POSSIBLE_CHARS_NUM; j++)
+			if (graph[i].transitions[j] != NULL && graph[i].transitions[j]->next != NULL)
+				return false;
+	}
+	return true;
+}
+
+/*****************************************************************
+ * Writes the C source of a deterministic machine: each state is
+ * a label with a switch on the tape symbol, each transition is a
+ * straight jump to the label of its next state
+ *****************************************************************/
+void generateMachineCode(FILE * f) {
+	fprintf(f, "#include <stdlib.h>\n#include <string.h>\n\n");
+	fprintf(f, "#define BLANK %d\n\n", BLANK);
+	fprintf(f, "#define GROW_RIGHT() do { t = realloc(t, 2*size); memset(&t[size], BLANK, size); size *= 2; } while (0)\n");
+	fprintf(f, "#define GROW_LEFT()  do { t = realloc(t, 2*size); memmove(&t[size], t, size); memset(t, BLANK, size); i += size; size *= 2; } while (0)\n\n");
+	fprintf(f, "char ndtm_jit_execute(const char * input, long int limit, long int * iteration, int (* expired)()) {\n");
+	fprintf(f, "\tlong int length = strlen(input);\n");
+	fprintf(f, "\tlong int size = length + 2*%d;\n", DEFAULT_PADDING_DIM);
+	fprintf(f, "\tchar * t = (char *) malloc(size);\n");
+	fprintf(f, "\tlong int i = %d;\n", DEFAULT_PADDING_DIM);
+	fprintf(f, "\tlong int it = 1;\n");
+	fprintf(f, "\tchar result;\n\n");
+	fprintf(f, "\tmemset(t, BLANK, size);\n");
+	fprintf(f, "\tmemcpy(&t[i], input, length);\n");
+	fprintf(f, "\tgoto s%d;\n\n", startingState);
+
+	for (int i = 0; i < states_num; i++) {
+		fprintf(f, "s%d:\n", i);
+		fprintf(f, "\tif (it > limit) goto undefined;\n");
+		fprintf(f, "\tif ((it & %d) == 0 && expired != NULL && expired() != 0) goto undefined;\n", BUDGET_CHECK_PERIOD - 1);
+		if (graph[i].transitions == NULL) {
+			fprintf(f, "\tgoto reject;\n");
+			continue;
+		}
+		fprintf(f, "\tswitch (t[i]) {\n");
+		for (int j = 0; j < POSSIBLE_CHARS_NUM; j++) {
+			graph_node * p = graph[i].transitions[j];
+			if (p == NULL)
+				continue;
+			fprintf(f, "\tcase %d:\n", p->in);
+			if (graph[p->next_state].isAccState == true) {
+				fprintf(f, "\t\tgoto accept;\n");
+				continue;
+			}
+			if (p->out != p->in)
+				fprintf(f, "\t\tt[i] = %d;\n", p->out);
+			fprintf(f, "\t\tit++;\n");
+			if (p->move == RIGHT)
+				fprintf(f, "\t\tif (++i == size) GROW_RIGHT();\n");
+			else if (p->move == LEFT)
+				fprintf(f, "\t\tif (--i < 0) GROW_LEFT();\n");
+			fprintf(f, "\t\tgoto s%d;\n", p->next_state);
+		}
+		fprintf(f, "\tdefault:\n\t\tgoto reject;\n\t}\n");
+	}
+
+	fprintf(f, "\naccept:\n\tresult = '%c';\n\tgoto end;\n", ACCEPT);
+	fprintf(f, "reject:\n\tresult = '%c';\n\tgoto end;\n", REJECT);
+	fprintf(f, "undefined:\n\tresult = '%c';\n", UNDEFINED);
+	fprintf(f, "end:\n\tfree(t);\n\t*iteration = it;\n\treturn result;\n}\n");
+}
+
+/*****************************************************************
+ * Compiles the machine to a shared object (reusing the cached one
+ * built for the same machine hash, if any) and loads it.
+ * Non-deterministic machines keep using the interpreter. Objects
+ * are only loaded from a directory, and as files, that belong to
+ * the user and that nobody else can write.
+ *****************************************************************/
+void loadMachineCode() {
+#ifdef JIT
+	if (isDeterministic() == false)
+		return;
+
+	char dir[PATH_MAX], object[PATH_MAX + 64];
+	bool temporary;
+	if (openMachineCodeDir(dir, sizeof(dir), &temporary) == false)
+		return;
+	unsigned long h = hashMachine();
+	snprintf(object, sizeof(object), "%s/ndtm_jit_%016lx.so", dir, h);
+
+	void * handle = NULL;
+	if (access(object, F_OK) == 0 || buildMachineCode(dir, h, object) == true) {
+		if (isPrivateFile(object, false) == true)
+			handle = dlopen(object, RTLD_NOW);
+		else if (DEBUG) printf("JIT: %s can be written by other users, not loaded\n", object);
+	}
+	if (temporary == true) {		// nothing is cached: the object is only needed until it is loaded
+		unlink(object);
+		rmdir(dir);
+	}
+	if (handle == NULL)
+		return;
+	jitExecute = (char (*)(const char *, long int, long int *, int (*)())) dlsym(handle, "ndtm_jit_execute");
+	if (DEBUG) printf("JIT: loaded %s\n", object);
+#endif
+}
+
+#ifdef JIT
+/*****************************************************************
+ * Writes in dir the directory of the shared objects: $NDTM_JIT_DIR
+ * or the ndtm directory of the user's cache, created if needed. If
+ * it isn't private (owned by the user, writable only by the user)
+ * a new private directory is made in /tmp, and *temporary is true.
+ *****************************************************************/
+bool openMachineCodeDir(char * dir, size_t dim, bool * temporary) {
+	const char * base = getenv("XDG_CACHE_HOME");
+	const char * home = getenv("HOME");
+
+	dir[0] = '\0';
+	if (getenv("NDTM_JIT_DIR") != NULL)
+		snprintf(dir, dim, "%s", getenv("NDTM_JIT_DIR"));
+	else if (base != NULL && base[0] == '/')
+		snprintf(dir, dim, "%s/%s", base, JIT_CACHE_DIR);
+	else if (home != NULL && home[0] == '/') {
+		snprintf(dir, dim, "%s/.cache", home);
+		mkdir(dir, 0700);
+		snprintf(dir, dim, "%s/.cache/%s", home, JIT_CACHE_DIR);
+	}
+
+	*temporary = false;
+	if (dir[0] != '\0') {
+		mkdir(dir, 0700);
+		if (isPrivateFile(dir, true) == true)
+			return true;
+		if (DEBUG) printf("JIT: %s is not private, using a temporary directory\n", dir);
+	}
+
+	snprintf(dir, dim, "%s", JIT_TEMP_DIR);
+	if (mkdtemp(dir) == NULL)		// made with mode 0700
+		return false;
+	*temporary = true;
+	return true;
+}
+
+/*****************************************************************
+ * Writes the source of the machine in dir and compiles it to the
+ * given object. The compiler is run without a shell; it writes a
+ * file of this process, which is renamed to the object, so that
+ * concurrent runs never load a partial object.
+ *****************************************************************/
+bool buildMachineCode(const char * dir, unsigned long h, const char * object) {
+	char source[PATH_MAX + 64], built[PATH_MAX + 64];
+	snprintf(source, sizeof(source), "%s/ndtm_jit_%016lx.%d.c", dir, h, (int) getpid());
+	snprintf(built, sizeof(built), "%s/ndtm_jit_%016lx.%d.so", dir, h, (int) getpid());
+
+	int fd = open(source, O_WRONLY | O_CREAT | O_EXCL, 0600);
+	if (fd == -1)
+		return false;
+	FILE * f = fdopen(fd, "w");
+	if (f == NULL) {
+		close(fd);
+		unlink(source);
+		return false;
+	}
+	generateMachineCode(f);
+	fclose(f);
+
+	int status = -1;
+	pid_t pid = fork();
+	if (pid == 0) {
+		char * const argv[] = { JIT_COMPILER, "-O2", "-w", "-shared", "-fPIC", "-o", built, source, NULL };
+		execvp(JIT_COMPILER, argv);
+		_exit(127);
+	}
+	if (pid > 0)
+		waitpid(pid, &status, 0);
+	unlink(source);
+
+	if (pid <= 0 || WIFEXITED(status) == 0 || WEXITSTATUS(status) != 0 || rename(built, object) != 0) {
+		if (DEBUG) printf("JIT: compilation of %s failed\n", source);
+		unlink(built);
+		return false;
+	}
+	return true;
+}
+
+/*****************************************************************
+ * Returns true if path is a directory (or a regular file, if
+ * directory is false) of the user that nobody else can write
+ *****************************************************************/
+bool isPrivateFile(const char * path, bool directory) {
+	struct stat info;
+	if (lstat(path, &info) != 0 || info.st_uid != getuid() || (info.st_mode & (S_IWGRP | S_IWOTH)) != 0)
+		return false;
+	return (directory == true) ? ((S_ISDIR(info.st_mode)) ? true : false) : ((S_ISREG(info.st_mode)) ? true : false);
+}
+#endif
+
+/*****************************************************************
+ * Frees the Turing Machine graph
+ *****************************************************************/
 void freeGraph() {
 	int i = 0;
 	graph_node * prec = NULL;
@@ -498,20 +2951,12 @@ void freeGraph() {
 }
 
 /*****************************************************************
- * Frees the transitions queue
+ * Frees the transitions queue: a tape shared by more transitions
+ * is given back once, with its last reference
  *****************************************************************/
  void freeQueue() {
-	 transition * p = transitionsQueue;
-
-	 while(transitionsQueue != NULL) {
-		 transitionsQueue = transitionsQueue->next;
-		 free(p->tape->string);
-		 free(p->tape);
-		 free(p);
-		 p = transitionsQueue;
-	 }
-
-	 transitionsQueue = NULL;
+	 while (transitionsQueue != NULL)
+		 removeFromQueue(&transitionsQueue, &transitionsQueueTail);
 	 transitionsQueueTail = NULL;
  }
 
@@ -531,7 +2976,7 @@ void printGraph() {
 						case 1: m = 'R'; break;
 						case -1: m = 'L'; break;
 					}
-					printf("\n%d %c %c %c %d", i, p->in, p->out, m, p->next_state);
+					printf("\n%ld %c %c %c %ld", stateIds[i], p->in, p->out, m, stateIds[p->next_state]);
 					p = p->next;
 				}
 			}
@@ -556,7 +3001,7 @@ void printQueue() {
 				case 1: m = 'R'; break;
 				case -1: m = 'L'; break;
 			}
-			printf("%d %c %c %d %d %s %d\n", p->state, p->in, p->out, m, p->next_state, p->tape->string, p->index);
+			printf("%ld %c %c %c %ld %d (%d written cells)\n", stateIds[p->state], p->in, p->out, m, stateIds[p->next_state], p->index, p->tape->writesNum);
 			p = p->next;
 		}
 		printf("\n");
@@ -579,9 +3024,81 @@ void printTape(int i, char * t) {
  * 						 Main function
  **************************************************************/
 int main(int argc, char * argv[]) {
+	int opt;
+	char * cachePath = NULL;
+	FILE * countersFile = NULL;
+	while ((opt = getopt(argc, argv, "s:t:m:c:C:bLMDw:P:B:Re:")) != -1) {
+		switch (opt) {
+			case 's': stepsBudget = atol(optarg);
+					  break;
+			case 't': timeBudget = atol(optarg);
+					  break;
+			case 'm': memoryBudget = atol(optarg);
+					  break;
+			case 'c': cacheCapacity = atoi(optarg);
+					  break;
+			case 'C': cachePath = optarg;
+					  break;
+			case 'b': batchMode = true;
+					  break;
+			case 'L': batchMode = true;
+					  lockstepMode = true;
+					  break;
+			case 'M': minimize = false;
+					  break;
+			case 'D': pruneDuplicates = false;
+					  break;
+			case 'w': witnessFile = fopen(optarg, "w");
+					  if (witnessFile == NULL) {
+						  fprintf(stderr, "Error: can't write %s\n", optarg);
+						  exit(1);
+					  }
+					  break;
+			case 'P': progressPeriod = atoi(optarg);
+					  break;
+			case 'R': tapeRuns = true;
+					  slotBytes = 2 * sizeof(int) + 1;
+					  break;
+			case 'e': countersFile = (strcmp(optarg, "-") == 0) ? stderr : fopen(optarg, "w");
+					  if (countersFile == NULL) {
+						  fprintf(stderr, "Error: can't write %s\n", optarg);
+						  exit(1);
+					  }
+					  break;
+			case 'B': if (strcmp(optarg, "steps") == 0)
+						  heuristic = BEST_FIRST_STEPS;
+					  else if (strcmp(optarg, "distance") == 0)
+						  heuristic = BEST_FIRST_DISTANCE;
+					  else if (strcmp(optarg, "progress") == 0)
+						  heuristic = BEST_FIRST_PROGRESS;
+					  else {
+						  fprintf(stderr, "Error: unknown heuristic %s (steps, distance or progress)\n", optarg);
+						  exit(1);
+					  }
+					  break;
+			default:  fprintf(stderr, "Usage: %s [-s steps budget] [-t time budget (ms)] [-m queue memory budget (bytes)] [-c cached results] [-C cache file] [-b] [-L] [-M] [-D] [-w witness file] [-P progress period (s)] [-B steps|distance|progress] [-R] [-e counters file] < input\n", argv[0]);
+					  exit(1);
+		}
+	}
+
+	if (witnessFile != NULL) {		// every accepted string is run by the interpreter, on the states of the input
+		minimize = false;
+		batchMode = false;
+		lockstepMode = false;
+		cacheCapacity = 0;
+		cachePath = NULL;
+	}
+
+	if (countersFile != NULL)
+		perfOpen(&counters, countersFile, "ndtm_iterative", 0);
+	perfStart(&counters);
 	graph = (state *) malloc(DEFAULT_STATES_DIM * sizeof(state));
 	initGraph();
 	readMTStructure();
+	if (minimize == true)
+		minimizeMachine();
+	computeAcceptingStates();
+	computeMoveDirections();
 
   if (DEBUG) {
   	printf("\nStates number: %d", states_num);
@@ -590,7 +3107,32 @@ int main(int argc, char * argv[]) {
   	printf("\n");
   }
 
+	if (witnessFile == NULL)
+		loadMachineCode();
+	if (jitExecute != NULL || memoryBudget != 0 || heuristic != BEST_FIRST_NONE)	// native code runs a single path, spilled
+		batchMode = false;																// levels cannot be copied, best-first has no levels
+	if (batchMode == false || isDeterministic() == false || states_num > LOCKSTEP_MAX_STATES)	// larger states would not fit
+		lockstepMode = false;																	// in the entries of the table
+	if (lockstepMode == true)
+		buildLockstepTable();
+	initCache();
+	if (cachePath != NULL)
+		openCacheFile(cachePath);
+	perfStop(&counters, 0, PERF_PARSE);
+
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = requestProgress;
+	action.sa_flags = SA_RESTART;		// the reads of the input go on after a signal
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGUSR1, &action, NULL);
+	if (progressPeriod != 0) {
+		sigaction(SIGALRM, &action, NULL);
+		alarm(progressPeriod);
+	}
+
 	readInputStrings();
+	perfClose(&counters);
 
     //freeGraph();
 	//printf("number of copies: %d\n", copiesNum);
@@ -10,6 +10,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/resource.h>
+#include "perfcounters.h"
 
 #define ACCEPT                 '1'
 #define REJECT                 '0'
@@ -19,11 +24,24 @@
 #define STOP  			        0
 #define BLANK 			       '_'
 #define DEFAULT_INPUT_DIM       256
-#define INPUT_INCREMENT		    128
+#define INPUT_GROWTH		      2		// the input array grows geometrically
 #define DEFAULT_PADDING_DIM     16
 #define DEFAULT_STATES_DIM      16
-#define STATES_INCREMENT        16
+#define STATES_GROWTH			  2		// the states array grows geometrically
+#define TOKEN_DIM				 32		// longest word of the machine description (state ids included)
 #define DEBUG 					0
+#define BUDGET_NONE				0
+#define BUDGET_STEPS			1		// the per-string steps budget has been exceeded
+#define BUDGET_TIME				2		// the per-string time budget has been exceeded
+#define BUDGET_CANCELLED		3		// another worker of the portfolio decided the string
+#define BUDGET_CHECK_PERIOD	 1024		// steps between two checks of the time budget and of the cancellation
+#define WORKER_STACK_DIM  (1 << 28)	// least stack of the workers (only the pages in use take memory)
+#define VISITED_DEFAULT_DIM (1 << 18)	// slots of the shared set of rejected configurations (a power of 2)
+#define VISITED_PROBES_NUM		8		// slots probed in the set before giving up
+#define VISITED_SAMPLE_DIM	 1024		// lookups over which the rate of the skipped configurations is measured
+#define VISITED_HIT_RATIO	  100		// with less than a skip every VISITED_HIT_RATIO lookups, the worker stops using the set
+#define FNV_OFFSET	14695981039346656037UL
+#define FNV_PRIME		1099511628211UL
 
 typedef enum {true, false} bool;
 
@@ -38,10 +56,17 @@ typedef struct transition {       // node of the graph
 typedef struct state {
 	transition * transitionsList;
 	bool isAccState;
+	bool canAccept;               // true if an acceptation state is reachable from this state
+	bool hasSelfLoop;             // true if at least a transition goes back to this state
 } state;
 
 typedef struct stack_node {
   char * tape;
+  int dim;                        // the cells of the tape (the string is NUL terminated after them)
+  int first;                      // the cells from first to last hold the input and the written cells,
+  int last;                       // the others are BLANK: copies of the tape keep only these
+  unsigned long hash;             // the configuration the tape starts from, for the set of rejected ones
+  unsigned long check;
   struct stack_node * next;
 } stack_node;
 
@@ -50,17 +75,33 @@ typedef struct acc_state {
 	struct acc_state * next;
 } acc_state;
 
+typedef struct state_slot {      // an id of the input in the map of the states
+	long int id;
+	int index;                    // where the state is in the graph, -1 if the slot is empty
+} state_slot;
+
+typedef struct visited_slot {     // a configuration from which all the paths reject, shared by the workers
+	_Atomic unsigned long hash;   // 0 if the slot is empty
+	_Atomic unsigned long check;  // second hash, to tell colliding configurations apart
+	_Atomic unsigned int iteration;  // the latest iteration the configuration was rejected at, 0 while it is written
+} visited_slot;
+
 void initGraph();
 void initTape();
 void readMTStructure();
 void addAcceptationState(int);
+int stateIndex(long int);
+unsigned long hashStateId(long int);
 void insertTransitionInGraph(int, char, char, int, int);
 void readInputStrings();
 void run();
 void executeTM(int, int, unsigned int);
 void performTransition(char *, int *, int *, unsigned int *);
 void performNonDeterministicTransition(char *, int, int, unsigned int);
-void putInStack(char *);
+void performShuffledTransitions(char *, int, int, unsigned int);
+static inline void followBranch(char *, int, unsigned int, transition *);
+transition ** shuffleTransitions(int, char);
+void putInStack(char *, int, int, int);
 void popFromStack();
 int countAccessibleTransitions(int, char);
 char * reallocTape(char *, int *);
@@ -72,25 +113,63 @@ void printStack();
 void freeGraph();
 void freeStack();
 void freeAccStatesList();
+void computeAcceptingStates();
+transition * findTransition(int, char);
+bool followPath(char *, int, int, transition *);
+bool checkBudget();
+void searchString(unsigned long);
+void runPortfolio();
+void * portfolioWorker(void *);
+unsigned long nextRandom();
+unsigned long hashConfiguration(char *, int, int, int, int, unsigned long);
+bool lookupConfiguration(int, int, unsigned int) __attribute__((noinline));
+bool isVisited(unsigned long, unsigned long, unsigned int);
+void markVisited(unsigned long, unsigned long, unsigned int);
 
 int states_num = 0;						// the number of states of the TM
 int states_dim = DEFAULT_STATES_DIM;    // the actual size of states array (graph)
 state * graph;				    // array containing all the states read from input
+long int * stateIds;					// the id of each state in the input (the graph is indexed densely)
+state_slot * stateSlots = NULL;			// map from the ids of the input to the indexes of the graph
+int stateSlotsDim = 0;
 
-stack_node * stack = NULL;              // the stack used to handle non-deterministic moves
+_Thread_local stack_node * stack = NULL;	// the stack used to handle non-deterministic moves (one for each worker)
 
-char * tape;                            // the tape of the Turing Machine
+_Thread_local char * tape;              // the tape of the Turing Machine
 
 int startingState = 0;                  // the starting state of the Turing Machine
 int reject_state = -1;    				// the state of rejection
 unsigned int iterationsLimit;           // the limit to the iteration number (to avoid machine loop)
 
-bool acceptString = false;              // true when a path accepts the input string
-bool atLeastAnUndefinedPath = false;    // true when at least a path returns UNDEFINED (iteration > iterationsLimit)
+_Thread_local bool acceptString = false;              // true when a path accepts the input string
+_Thread_local bool atLeastAnUndefinedPath = false;    // true when at least a path returns UNDEFINED (iteration > iterationsLimit)
 
 int input_dim;							// the current length of the inputString array
 char * inputString;						// the string read from input
 
+long int stepsBudget = 0;				// maximum number of steps (over all the paths) for each string, 0 if unlimited
+long int timeBudget = 0;				// maximum execution time (milliseconds) for each string, 0 if unlimited
+_Thread_local long int stepsNum;		// the number of steps performed on the current string
+struct timespec startTime;				// when the computation of the current string started
+_Thread_local int budgetExceeded = BUDGET_NONE;	// which budget, if any, stopped the current computation
+int stringsNum = 0;						// the number of strings read so far
+
+int workersNum = 1;						// DFS searches run in parallel on each string, in different orders
+_Thread_local unsigned long randomState = 0;	// random generator of the worker, 0 to follow the transitions in input order
+atomic_int portfolioDone;				// set when a worker decides the string, the others stop
+pthread_mutex_t portfolioLock = PTHREAD_MUTEX_INITIALIZER;
+char portfolioResult;					// the result of the worker that decided the string
+int portfolioBudget;					// the budget that stopped the workers, if none decided the string
+
+visited_slot * visitedSlots = NULL;		// configurations already rejected, shared by the workers (NULL if not used)
+unsigned long visitedDim = 0;
+atomic_long visitedNum;					// the configurations added for the current string
+_Thread_local bool useVisited;			// false once the set skipped too few configurations of the worker to pay for the hashes
+_Thread_local long int visitedLookups;	// lookups and skipped configurations since the last measure of their rate
+_Thread_local long int visitedHits;
+
+perf_counters counters;					// hardware counters of the phases (off unless -e is given)
+
 /***************************************************************
  * Initializes graph (states vector) elements to NULL
  ***************************************************************/
@@ -98,6 +177,8 @@ void initGraph() {
 	for(int i = 0; i < DEFAULT_STATES_DIM; i++) {
 		graph[i].transitionsList = NULL;
 		graph[i].isAccState = false;
+		graph[i].canAccept = false;
+		graph[i].hasSelfLoop = false;
 	}
 }
 
@@ -105,25 +186,28 @@ void initGraph() {
  * Reads the stdin (MT structure) saving data in program structures
  *******************************************************************/
 void readMTStructure() {
-	int s = -1;
+	long int s = -1;
 	char inputChar = ' ';
 	char outputChar = ' ';
 	char move = ' ';
-	int next_s = -1;
-	char in[5];
+	long int next_s = -1;
+	char in[TOKEN_DIM];
 
-	scanf("%s", in);
+	stateIds = (long int *) malloc(states_dim * sizeof(long int));
+	stateIndex(startingState);		// the starting state is the first one, whatever comes first in the input
+
+	scanf("%31s", in);
 	if (strcmp(in, "tr") != 0)
 		exit(0);
 
-	scanf("%s", in);
+	scanf("%31s", in);
 	while (strcmp(in, "acc") != 0) { 	// cycle until find the word "acc"
-		sscanf(in, "%d", &s); 		 	// read state
-		scanf("%s", in);
+		sscanf(in, "%ld", &s); 		 	// read state
+		scanf("%31s", in);
 		inputChar = in[0];    		    // read input character
-		scanf("%s", in);
+		scanf("%31s", in);
 		outputChar = in[0];   		 	// read output character
-		scanf("%s", in);				// read move
+		scanf("%31s", in);				// read move
 		switch(in[0]) {
 			case 'R': move = RIGHT;
 					  break;
@@ -134,44 +218,94 @@ void readMTStructure() {
 			default:  printf("Invalid move character\n");
 					  break;
 		}
-		scanf("%s", in);
-		sscanf(in, "%d", &next_s);   					// read next state
-		if (s >= states_num || next_s >= states_num) {	// maintain the maximum state number
-			if (s >= next_s)
-				states_num = s + 1;
-			else
-				states_num = next_s + 1;
-		}
-		if (states_num >= states_dim) {
-			int newDim = states_num + STATES_INCREMENT;
-			graph = (state *) realloc(graph, newDim * sizeof(state));
-			// re-initialize states vector (graph) with NULL in new positions
-			for (int i = states_dim; i < newDim; i++) {
-				graph[i].transitionsList = NULL;
-				graph[i].isAccState = false;
-			}
-			states_dim = newDim;
-			if (DEBUG) printf("RIALLOCO VETTORE STATI (dim = %d)\n", states_dim);
-		}
-		insertTransitionInGraph(s, inputChar, outputChar, move, next_s);
-		scanf("%s", in);
+		scanf("%31s", in);
+		sscanf(in, "%ld", &next_s);   					// read next state
+		int from = stateIndex(s);
+		insertTransitionInGraph(from, inputChar, outputChar, move, stateIndex(next_s));
+		scanf("%31s", in);
 	}
 
-	int accState;
-	scanf("%s", in);
+	long int accState;
+	scanf("%31s", in);
 	while (strcmp(in, "max") != 0) { 	// read acceptation states
-		sscanf(in, "%d", &accState);
-		graph[accState].isAccState = true;
-		scanf("%s", in);
+		sscanf(in, "%ld", &accState);
+		graph[stateIndex(accState)].isAccState = true;
+		scanf("%31s", in);
 	}
 
 	scanf("%u", &iterationsLimit);    // read maximum number of iterations
 
-	scanf("%s", in);                  // read the word "run" to start computations
+	scanf("%31s", in);                  // read the word "run" to start computations
 	if (strcmp(in, "run") != 0)
 		exit(0);
 	else
 		getchar(); // consume '\n' character after "run" string
+
+	free(stateSlots);
+	stateSlots = NULL;
+}
+
+/*****************************************************************
+ * Returns the index in the graph of the state with the given id,
+ * adding the state if it is new: the states are numbered densely,
+ * in order of appearance, so the memory doesn't depend on the ids
+ *****************************************************************/
+int stateIndex(long int id) {
+	if (2 * (states_num + 1) > stateSlotsDim) {		// keep the map at most half full
+		int oldDim = stateSlotsDim;
+		state_slot * old = stateSlots;
+		stateSlotsDim = (stateSlotsDim == 0) ? 2 * DEFAULT_STATES_DIM : 2 * stateSlotsDim;
+		stateSlots = (state_slot *) malloc(stateSlotsDim * sizeof(state_slot));
+		for (int i = 0; i < stateSlotsDim; i++)
+			stateSlots[i].index = -1;
+		for (int i = 0; i < oldDim; i++) {
+			if (old[i].index == -1)
+				continue;
+			unsigned long h = hashStateId(old[i].id) & (stateSlotsDim - 1);
+			while (stateSlots[h].index != -1)
+				h = (h + 1) & (stateSlotsDim - 1);
+			stateSlots[h] = old[i];
+		}
+		free(old);
+	}
+
+	unsigned long h = hashStateId(id) & (stateSlotsDim - 1);
+	while (stateSlots[h].index != -1) {
+		if (stateSlots[h].id == id)
+			return stateSlots[h].index;
+		h = (h + 1) & (stateSlotsDim - 1);
+	}
+
+	if (states_num == states_dim) {
+		int newDim = states_dim * STATES_GROWTH;
+		graph = (state *) realloc(graph, newDim * sizeof(state));
+		stateIds = (long int *) realloc(stateIds, newDim * sizeof(long int));
+		// re-initialize states vector (graph) with NULL in new positions
+		for (int i = states_dim; i < newDim; i++) {
+			graph[i].transitionsList = NULL;
+			graph[i].isAccState = false;
+			graph[i].canAccept = false;
+			graph[i].hasSelfLoop = false;
+		}
+		states_dim = newDim;
+		if (DEBUG) printf("RIALLOCO VETTORE STATI (dim = %d)\n", states_dim);
+	}
+	stateSlots[h].id = id;
+	stateSlots[h].index = states_num;
+	stateIds[states_num] = id;
+	return states_num++;
+}
+
+/*****************************************************************
+ * Hashes a state id of the input (FNV-1a over its bytes)
+ *****************************************************************/
+unsigned long hashStateId(long int id) {
+	unsigned long h = FNV_OFFSET;
+	for (int k = 0; k < (int) sizeof(id); k++) {
+		h ^= ((unsigned char *) &id)[k];
+		h *= FNV_PRIME;
+	}
+	return h;
 }
 
 /****************************************************************
@@ -189,7 +323,7 @@ void readInputStrings() {
 		c = getchar();
 		//printf("%d ", c);
 		if (i == input_dim && c != EOF) {
-			int newDim = input_dim + INPUT_INCREMENT;
+			int newDim = input_dim * INPUT_GROWTH;
 			inputString = (char *) realloc(inputString, newDim);
 			input_dim = newDim;
 			if (DEBUG) printf("RIALLOCO VETTORE INPUT (dim = %d)\n", input_dim);
@@ -229,6 +363,9 @@ void insertTransitionInGraph(int s, char in, char out, int m, int n_s) {
 		exit(0);
 	}
 
+	if (s == n_s)
+		graph[s].hasSelfLoop = true;
+
 	if (graph[s].transitionsList == NULL) {   // insert when list is empty
 		graph[s].transitionsList = new;
 		new->next = NULL;
@@ -254,25 +391,109 @@ void insertTransitionInGraph(int s, char in, char out, int m, int n_s) {
 
 //***************************************
 void run() {
+    stringsNum++;
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+    if (visitedSlots != NULL && atomic_load(&visitedNum) != 0) {	// the configurations of the previous string
+        memset(visitedSlots, 0, visitedDim * sizeof(visited_slot));
+        atomic_store(&visitedNum, 0);
+    }
+    perfStart(&counters);
+    if (workersNum > 1) {
+        runPortfolio();
+        perfStop(&counters, stringsNum, PERF_EXECUTE);
+        return;
+    }
+    searchString(0);
+    perfStop(&counters, stringsNum, PERF_EXECUTE);
+    if (budgetExceeded != BUDGET_NONE)   // computation stopped before the answer was decided
+        fprintf(stderr, "string %d: %s budget exceeded\n", stringsNum, (budgetExceeded == BUDGET_STEPS) ? "steps" : "time");
+    printf("%c\n", checkComputationResult());
+}
+
+/*****************************************************************
+ * Runs the DFS on the current string. With seed 0 the transitions
+ * are followed in input order, otherwise in a random order given
+ * by the seed.
+ *****************************************************************/
+void searchString(unsigned long seed) {
+    randomState = seed;
+    useVisited = true;
+    visitedLookups = 0;
+    visitedHits = 0;
     initTape();
-    putInStack(tape);
+    int length = (int) strlen(inputString);
+    putInStack(tape, length + 2*DEFAULT_PADDING_DIM - 1, DEFAULT_PADDING_DIM, DEFAULT_PADDING_DIM + length - 1);
     acceptString = false;
     atLeastAnUndefinedPath = false;
+    stepsNum = 0;
+    budgetExceeded = BUDGET_NONE;
     executeTM(DEFAULT_PADDING_DIM, startingState, 1);
-    printf("%c\n", checkComputationResult());
-    //freeStack();
+    popFromStack();
+}
+
+/*****************************************************************
+ * Runs workersNum DFS searches on the current string, each with
+ * its own order of the non-deterministic transitions (the first
+ * one in input order). Each search is complete, so the first one
+ * that ends, accepting or not, decides the string and the others
+ * are cancelled. If all of them are stopped by a budget, the
+ * string is UNDEFINED.
+ *****************************************************************/
+void runPortfolio() {
+    pthread_t workers[workersNum];
+    pthread_attr_t attr;
+    struct rlimit limit;
+
+    // the DFS recursion of the workers gets at least as much stack as the main thread, as
+    // their frames are a little larger (they keep the shuffled transitions of each level)
+    pthread_attr_init(&attr);
+    if (getrlimit(RLIMIT_STACK, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur > WORKER_STACK_DIM)
+        pthread_attr_setstacksize(&attr, limit.rlim_cur);
+    else pthread_attr_setstacksize(&attr, WORKER_STACK_DIM);
+
+    atomic_store(&portfolioDone, 0);
+    portfolioBudget = BUDGET_NONE;
+    for (long int w = 0; w < workersNum; w++)
+        pthread_create(&workers[w], &attr, portfolioWorker, (void *) w);
+    for (int w = 0; w < workersNum; w++)
+        pthread_join(workers[w], NULL);
+    pthread_attr_destroy(&attr);
+
+    if (atomic_load(&portfolioDone) == 0) {
+        fprintf(stderr, "string %d: %s budget exceeded\n", stringsNum, (portfolioBudget == BUDGET_STEPS) ? "steps" : "time");
+        portfolioResult = UNDEFINED;
+    }
+    printf("%c\n", portfolioResult);
+}
+
+//***************************************
+void * portfolioWorker(void * arg) {
+    long int w = (long int) arg;
+    searchString((w == 0) ? 0 : FNV_OFFSET ^ (w * FNV_PRIME));
+
+    pthread_mutex_lock(&portfolioLock);
+    if (budgetExceeded == BUDGET_NONE && atomic_load(&portfolioDone) == 0) {	// the first complete search
+        portfolioResult = checkComputationResult();
+        atomic_store(&portfolioDone, 1);
+    }
+    else if (budgetExceeded == BUDGET_STEPS || budgetExceeded == BUDGET_TIME)
+        portfolioBudget = budgetExceeded;
+    pthread_mutex_unlock(&portfolioLock);
+    return NULL;
 }
 
 //***************************************
 void executeTM(int index, int currState, unsigned int iteration) {
 
-	if (acceptString == true) // end the computation, string already accepted
+	if (acceptString == true || budgetExceeded != BUDGET_NONE) // end the computation, string already accepted
 		return;
 
 	char * currTape = stack->tape;
 	int accessibleTransitions = countAccessibleTransitions(currState, currTape[index]);
 
-	while (acceptString == false && iteration <= iterationsLimit && accessibleTransitions != 0) {
+	// once the result is UNDEFINED, only paths that can still reach an acceptation state are followed
+	while (acceptString == false && iteration <= iterationsLimit && accessibleTransitions != 0 &&
+		   (atLeastAnUndefinedPath == false || graph[currState].canAccept == true) && checkBudget() == false) {
 
 		if (DEBUG) {
 			//sleep(1);
@@ -287,10 +508,13 @@ void executeTM(int index, int currState, unsigned int iteration) {
 			return;
 		}
 		else {
+			if (graph[currState].hasSelfLoop == true &&
+				followPath(currTape, currState, index, findTransition(currState, currTape[index])) == false)
+				return;
 			performTransition(currTape, &currState, &index, &iteration);
 		}
 
-		if (index == -1 || index == strlen(currTape))
+		if (index == -1 || index == stack->dim)
 			currTape = reallocTape(currTape, &index);
 
 		accessibleTransitions = countAccessibleTransitions(currState, currTape[index]);
@@ -320,14 +544,19 @@ void performTransition(char * currTape, int * state, int * i, unsigned int * it)
 		if (p->in == currTape[*i]) {
 			if (DEBUG) printf("----------   Deterministic Transition   ----------\n");
 			found = true;
+			stepsNum++;
 			currTape[*i] = p->out;
+			if (*i < stack->first)		// the written cell joins the window of the tape
+				stack->first = *i;
+			else if (*i > stack->last)
+				stack->last = *i;
 			if (DEBUG) printf("index: %d\n", *i);
 			*i = *i + p->move;
 			if (DEBUG) printf("new index: %d\n", *i);
 			*it = *it + 1;
 			if (DEBUG) printf("iteration: %u\n", *it);
 			*state = p->next_state;
-			if (DEBUG) printf("new state: %d\n", *state);
+			if (DEBUG) printf("new state: %ld\n", stateIds[*state]);
 		}
 		p = p->next;
 	}
@@ -335,45 +564,106 @@ void performTransition(char * currTape, int * state, int * i, unsigned int * it)
 
 //****************************************
 void performNonDeterministicTransition(char * currTape, int state, int i, unsigned int it) {
+	if (randomState != 0) {		// the workers of the portfolio try the transitions in different orders
+		performShuffledTransitions(currTape, state, i, it);
+		return;
+	}
 	transition * p = graph[state].transitionsList;
 	while (p != NULL) {
-		if (p->in == currTape[i]) {
-			if (DEBUG) printf("**********   NON-DETERMINISTIC TRANSITION   **********\n");
-			if (DEBUG) {
-				printf("index: %d\n", i);
-				printf("new index: %d\n", i+p->move);
-				printf("iteration: %u\n", it+1);
-				printf("new state: %d\n", p->next_state);
-			}
-			char * newTape = (char *) malloc(strlen(currTape)+1);
-			strcpy(newTape, currTape);
-			newTape[i] = p->out;
-			if (DEBUG) printf("new tape: %s\n", newTape);
-			putInStack(newTape);
-			executeTM(i+p->move, p->next_state, it+1);
-			popFromStack();
-		}
+		if (p->in == currTape[i] && followPath(currTape, state, i, p) == true)
+			followBranch(currTape, i, it, p);
 		p = p->next;
 	}
 }
 
+//****************************************
+void performShuffledTransitions(char * currTape, int state, int i, unsigned int it) {
+	transition ** order = shuffleTransitions(state, currTape[i]);
+	for (int k = 0; order[k] != NULL; k++)
+		if (followPath(currTape, state, i, order[k]) == true)
+			followBranch(currTape, i, it, order[k]);
+	free(order);
+}
+
+/****************************************************************
+* Follows a non-deterministic transition on a copy of the tape.
+* What is needed after the recursion is kept in the stack node, so
+* that the frames of the DFS recursion stay small.
+****************************************************************/
+static inline __attribute__((always_inline)) void followBranch(char * currTape, int i, unsigned int it, transition * p) {
+	if (DEBUG) printf("**********   NON-DETERMINISTIC TRANSITION   **********\n");
+	stepsNum++;
+	if (DEBUG) {
+		printf("index: %d\n", i);
+		printf("new index: %d\n", i+p->move);
+		printf("iteration: %u\n", it+1);
+		printf("new state: %ld\n", stateIds[p->next_state]);
+	}
+	// the new tape has the window of the current one (with the written cell) and fresh padding
+	int first = (i < stack->first) ? i : stack->first;
+	int last = (i > stack->last) ? i : stack->last;
+	int shift = DEFAULT_PADDING_DIM - first;
+	int dim = last - first + 1 + 2*DEFAULT_PADDING_DIM;
+	char * newTape = (char *) malloc(dim + 1);
+	memset(newTape, BLANK, DEFAULT_PADDING_DIM);
+	memcpy(&newTape[DEFAULT_PADDING_DIM], &currTape[first], last - first + 1);
+	memset(&newTape[last + shift + 1], BLANK, DEFAULT_PADDING_DIM);
+	newTape[dim] = '\0';
+	newTape[i + shift] = p->out;
+	if (DEBUG) printf("new tape: %s\n", newTape);
+
+	putInStack(newTape, dim, first + shift, last + shift);
+	if (visitedSlots != NULL && lookupConfiguration(p->next_state, i + shift + p->move, it+1) == true) {
+		popFromStack();		// already rejected by a search
+		return;
+	}
+	executeTM(i + shift + p->move, p->next_state, it+1);
+
+	// all the paths of the subtree have been followed and rejected
+	if (visitedSlots != NULL && stack->hash != 0 && acceptString == false && budgetExceeded == BUDGET_NONE && atLeastAnUndefinedPath == false)
+		markVisited(stack->hash, stack->check, it+1);
+	popFromStack();
+}
+
+/****************************************************************
+* Returns the transitions from state reading c in a random order
+* (given by the generator of the worker), NULL terminated. The
+* array is on the heap, so that the frames of the DFS recursion
+* stay small.
+****************************************************************/
+transition ** shuffleTransitions(int state, char c) {
+	int n = countAccessibleTransitions(state, c);
+	transition ** order = (transition **) malloc((n + 1) * sizeof(transition *));
+	int k = 0;
+	for (transition * p = graph[state].transitionsList; p != NULL; p = p->next)
+		if (p->in == c)
+			order[k++] = p;
+	order[n] = NULL;
+
+	for (k = n - 1; k > 0; k--) {
+		int r = nextRandom() % (k + 1);
+		transition * swap = order[k];
+		order[k] = order[r];
+		order[r] = swap;
+	}
+	return order;
+}
+
 /****************************************************************
 * Reallocates the current tape of the Turing Machine
 ****************************************************************/
 char * reallocTape(char * currTape, int * index) {
 
-	int length = strlen(currTape)+1;
-	char * tapeCopy;
+	int length = stack->dim + 1;
 
 	if (*index == -1) {
-		tapeCopy = (char *) malloc(length);
-		strcpy(tapeCopy, currTape);
 		currTape = realloc(currTape, length + DEFAULT_PADDING_DIM);
+		memmove(&currTape[DEFAULT_PADDING_DIM], currTape, length);
 		for (int i = 0; i < DEFAULT_PADDING_DIM; i++)
 			currTape[i] = BLANK;
-		strcpy(&currTape[DEFAULT_PADDING_DIM], tapeCopy);
-		free(tapeCopy);
 		*index = *index + DEFAULT_PADDING_DIM;
+		stack->first += DEFAULT_PADDING_DIM;
+		stack->last += DEFAULT_PADDING_DIM;
   	}
   	else {
 		currTape = realloc(currTape, length + DEFAULT_PADDING_DIM);
@@ -383,16 +673,20 @@ char * reallocTape(char * currTape, int * index) {
 
 	currTape[length+DEFAULT_PADDING_DIM-1] = '\0';
 	stack->tape = currTape;
-	//printf("\nRIALLOCO VETTORE TAPE (dim = %d)\n\n", (int) strlen(currTape));
+	stack->dim += DEFAULT_PADDING_DIM;
+	//printf("\nRIALLOCO VETTORE TAPE (dim = %d)\n\n", stack->dim);
 	return currTape;
 }
 
 //***************************************
-void putInStack(char * string) {
+void putInStack(char * string, int dim, int first, int last) {
     stack_node * new = (stack_node *) malloc(sizeof(stack_node));
     if (string == NULL || new == NULL)
         return;
     new->tape = string;
+    new->dim = dim;
+    new->first = first;
+    new->last = last;
     new->next = stack;
     stack = new;
 
@@ -431,6 +725,205 @@ int countAccessibleTransitions(int state, char c) {
 	return i;
 }
 
+//****************************************************************
+transition * findTransition(int state, char c) {
+	transition * p = graph[state].transitionsList;
+	while (p != NULL && p->in != c)
+		p = p->next;
+	return p;
+}
+
+/*****************************************************************
+ * Marks the states from which an acceptation state is reachable
+ *****************************************************************/
+void computeAcceptingStates() {
+	bool changed = true;
+
+	for (int i = 0; i < states_num; i++)
+		graph[i].canAccept = graph[i].isAccState;
+
+	while (changed == true) {
+		changed = false;
+		for (int i = 0; i < states_num; i++) {
+			if (graph[i].canAccept == true)
+				continue;
+			for (transition * p = graph[i].transitionsList; p != NULL; p = p->next) {
+				if (graph[p->next_state].canAccept == true) {
+					graph[i].canAccept = true;
+					changed = true;
+					break;
+				}
+			}
+		}
+	}
+}
+
+/*****************************************************************
+ * Decides if the path taking transition p from the given state
+ * and index has to be followed: once the result is UNDEFINED,
+ * paths that can't reach an acceptation state can't change it
+ * anymore; paths that provably loop forever make it UNDEFINED
+ * without being followed
+ *****************************************************************/
+bool followPath(char * currTape, int state, int index, transition * p) {
+	if (atLeastAnUndefinedPath == true && graph[p->next_state].canAccept == false)
+		return false;
+
+	if (state != p->next_state)
+		return true;
+
+	if (p->in == p->out && p->move == STOP) {	// same configuration again and again
+		atLeastAnUndefinedPath = true;
+		return false;
+	}
+
+	// the only transition on BLANK, moving towards a region that contains only BLANK characters
+	if (p->in != BLANK || countAccessibleTransitions(state, BLANK) != 1 || p->move == STOP)
+		return true;
+	if (p->move == RIGHT) {		// outside the window of the tape all the cells are BLANK
+		for (int i = index + 1; i <= stack->last; i++)
+			if (currTape[i] != BLANK)
+				return true;
+	}
+	else {
+		for (int i = index - 1; i >= stack->first; i--)
+			if (currTape[i] != BLANK)
+				return true;
+	}
+	atLeastAnUndefinedPath = true;
+	return false;
+}
+
+/*****************************************************************
+ * Returns true if the current string exceeded one of its budgets
+ *****************************************************************/
+bool checkBudget() {
+	if (stepsBudget != 0 && stepsNum > stepsBudget)
+		budgetExceeded = BUDGET_STEPS;
+	else if (stepsNum % BUDGET_CHECK_PERIOD == 0) {
+		if (atomic_load_explicit(&portfolioDone, memory_order_relaxed) != 0)	// another worker decided the string
+			budgetExceeded = BUDGET_CANCELLED;
+		else if (timeBudget != 0) {
+			struct timespec now;
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			if ((now.tv_sec - startTime.tv_sec) * 1000 + (now.tv_nsec - startTime.tv_nsec) / 1000000 > timeBudget)
+				budgetExceeded = BUDGET_TIME;
+		}
+	}
+	return (budgetExceeded != BUDGET_NONE) ? true : false;
+}
+
+/*****************************************************************
+ * Returns the next number of the random generator of the worker
+ * (xorshift)
+ *****************************************************************/
+unsigned long nextRandom() {
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 7;
+	randomState ^= randomState << 17;
+	return randomState;
+}
+
+/*****************************************************************
+ * Hashes a configuration (FNV-1a, starting from seed): the state,
+ * the written part of the tape and the head position relative to
+ * it, so that the same configuration gives the same hash whatever
+ * the padding of the tape. Only the window from first to last is
+ * read, the cells outside it are BLANK.
+ *****************************************************************/
+unsigned long hashConfiguration(char * t, int first, int last, int state, int index, unsigned long seed) {
+	while (first <= last && t[first] == BLANK)
+		first++;
+	while (last >= first && t[last] == BLANK)
+		last--;
+
+	unsigned long h = seed;
+	int fields[2] = { state, index - first };
+	for (int k = 0; k < (int) sizeof(fields); k++) {
+		h ^= ((unsigned char *) fields)[k];
+		h *= FNV_PRIME;
+	}
+	for (int k = first; k <= last; k++) {
+		h ^= (unsigned char) t[k];
+		h *= FNV_PRIME;
+	}
+	return (h == 0) ? 1 : h;
+}
+
+/*****************************************************************
+ * Returns true if the configuration on top of the stack, with the
+ * given state and head, has already been rejected by a search (at
+ * the given iteration or later), keeping its hashes in the stack
+ * node. A hash is never 0: the hashes are 0 when the worker no
+ * longer uses the set, because VISITED_SAMPLE_DIM lookups skipped less
+ * than one configuration every VISITED_HIT_RATIO. Not inlined, so
+ * that the frames of the DFS recursion stay small.
+ *****************************************************************/
+bool lookupConfiguration(int state, int index, unsigned int iteration) {
+	stack->hash = 0;
+	stack->check = 0;
+	if (useVisited == false)
+		return false;
+
+	stack->hash = hashConfiguration(stack->tape, stack->first, stack->last, state, index, FNV_OFFSET);
+	stack->check = hashConfiguration(stack->tape, stack->first, stack->last, state, index, ~FNV_OFFSET);
+	bool skip = isVisited(stack->hash, stack->check, iteration);
+	if (skip == true)
+		visitedHits++;
+	if (++visitedLookups == VISITED_SAMPLE_DIM) {	// too few skips: the hashes cost more than they save
+		if (visitedHits * VISITED_HIT_RATIO < visitedLookups)
+			useVisited = false;
+		visitedLookups = 0;
+		visitedHits = 0;
+	}
+	return skip;
+}
+
+/*****************************************************************
+ * Returns true if the configuration has been rejected at the given
+ * iteration or later: all its paths fit in the remaining steps, so
+ * they reject again
+ *****************************************************************/
+bool isVisited(unsigned long hash, unsigned long check, unsigned int iteration) {
+	for (int k = 0; k < VISITED_PROBES_NUM; k++) {
+		visited_slot * v = &visitedSlots[(hash + k) & (visitedDim - 1)];
+		unsigned long h = atomic_load_explicit(&v->hash, memory_order_relaxed);
+		if (h == 0)
+			return false;
+		if (h != hash)
+			continue;
+		unsigned int it = atomic_load_explicit(&v->iteration, memory_order_acquire);
+		if (it != 0 && iteration <= it && atomic_load_explicit(&v->check, memory_order_relaxed) == check)
+			return true;
+	}
+	return false;
+}
+
+/*****************************************************************
+ * Adds a configuration all whose paths have been rejected, at the
+ * given iteration, to the set shared by the workers. The set is
+ * not grown: when the probed slots are taken, it is not added.
+ *****************************************************************/
+void markVisited(unsigned long hash, unsigned long check, unsigned int iteration) {
+	for (int k = 0; k < VISITED_PROBES_NUM; k++) {
+		visited_slot * v = &visitedSlots[(hash + k) & (visitedDim - 1)];
+		unsigned long h = 0;
+		if (atomic_compare_exchange_strong(&v->hash, &h, hash) == 1) {	// empty slot, now taken
+			atomic_store_explicit(&v->check, check, memory_order_relaxed);
+			atomic_store_explicit(&v->iteration, iteration, memory_order_release);
+			atomic_fetch_add(&visitedNum, 1);
+			return;
+		}
+		if (h != hash)
+			continue;
+		unsigned int it = atomic_load_explicit(&v->iteration, memory_order_acquire);
+		if (it == 0 || atomic_load_explicit(&v->check, memory_order_relaxed) != check)
+			continue;
+		while (it < iteration && atomic_compare_exchange_weak(&v->iteration, &it, iteration) == 0);	// keep the latest
+		return;
+	}
+}
+
 /*************************************************************************
  * Initializes tape with BLANK charaters before and after the input string
  *************************************************************************/
@@ -452,7 +945,7 @@ void initTape() {
 char checkComputationResult() {
 	if (acceptString == true)             // at least a path accpets the string ---> ACCEPT STRING
         return ACCEPT;
-	if (atLeastAnUndefinedPath == true)   // at least an undefined value ---> UNDEFINED
+	if (atLeastAnUndefinedPath == true || budgetExceeded != BUDGET_NONE)   // at least an undefined value ---> UNDEFINED
 		return UNDEFINED;
 	return REJECT;                        // only rejection values ---> REJECT STRING
 }
@@ -503,7 +996,7 @@ void printGraph() {
 					case 1: m = 'R'; break;
 					case -1: m = 'L'; break;
 				}
-				printf("\n%d %c %c %c %d", i, p->in, p->out, m, p->next_state);
+				printf("\n%ld %c %c %c %ld", stateIds[i], p->in, p->out, m, stateIds[p->next_state]);
 				p = p->next;
 			}
 		}
@@ -542,9 +1035,44 @@ void printStack() {
  * 						 Main function
  **************************************************************/
 int main(int argc, char * argv[]) {
+	int opt;
+	bool visited = false;
+	FILE * countersFile = NULL;
+	while ((opt = getopt(argc, argv, "s:t:j:Ve:")) != -1) {
+		switch (opt) {
+			case 's': stepsBudget = atol(optarg);
+					  break;
+			case 't': timeBudget = atol(optarg);
+					  break;
+			case 'j': workersNum = atoi(optarg);
+					  if (workersNum < 1)
+						  workersNum = 1;
+					  break;
+			case 'V': visited = true;
+					  break;
+			case 'e': countersFile = (strcmp(optarg, "-") == 0) ? stderr : fopen(optarg, "w");
+					  if (countersFile == NULL) {
+						  fprintf(stderr, "Error: can't write %s\n", optarg);
+						  exit(1);
+					  }
+					  break;
+			default:  fprintf(stderr, "Usage: %s [-s steps budget] [-t time budget (ms)] [-j workers] [-V] [-e counters file] < input\n", argv[0]);
+					  exit(1);
+		}
+	}
+
+	if (countersFile != NULL)		// the counters of the threads of -j are added to the ones of this thread
+		perfOpen(&counters, countersFile, "ndtm_recursive", 1);
+	perfStart(&counters);
 	graph = (state *) malloc(DEFAULT_STATES_DIM * sizeof(state));
 	initGraph();
 	readMTStructure();
+	computeAcceptingStates();
+	perfStop(&counters, 0, PERF_PARSE);
+	if (visited == true) {
+		visitedDim = VISITED_DEFAULT_DIM;
+		visitedSlots = (visited_slot *) calloc(visitedDim, sizeof(visited_slot));
+	}
 
   if (DEBUG) {
   	printf("\nStates number: %d", states_num);
@@ -556,8 +1084,11 @@ int main(int argc, char * argv[]) {
 	readInputStrings();
 
     #ifdef EVAL
+        perfStart(&counters);
         freeGraph();
+        perfStop(&counters, 0, PERF_TEARDOWN);
     #endif
+	perfClose(&counters);
 
 	return 0;
 }
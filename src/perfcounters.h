@@ -0,0 +1,175 @@
+//
+//  perfcounters.h
+//  ndtm
+//
+//  Hardware performance counters read around the phases of the
+//  simulators (parse, execute, teardown), with perf_event_open on
+//  Linux. Each phase writes a line with the elapsed nanoseconds, the
+//  cycles, the instructions, the L1 data cache and last level cache
+//  misses and the branch misses it took; when the engine ends, the
+//  totals of each phase over all the strings are written too.
+//
+//  A counter the kernel or the processor doesn't provide (or that
+//  perf_event_paranoid forbids) is written as "-": the times are
+//  always there. The functions are static, so each simulator is
+//  still built from its own file.
+//
+
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#define PERF_COUNTERS_NUM          5
+#define PERF_PHASES_NUM            3
+#define PERF_PARSE                 0		// reading the machine (and preparing it)
+#define PERF_EXECUTE               1		// running a string
+#define PERF_TEARDOWN              2		// freeing what a string (or the engine) used
+
+typedef struct perf_counters {
+	FILE * out;                                       // where the lines are written, NULL if counters are off
+	const char * engine;                              // name of the simulator in the lines
+	int fd[PERF_COUNTERS_NUM];                        // -1 for the counters that are not available
+	unsigned long long start[PERF_COUNTERS_NUM];      // values at the start of the current phase
+	struct timespec startTime;
+	unsigned long long totals[PERF_PHASES_NUM][PERF_COUNTERS_NUM + 1];   // nanoseconds, then the counters
+	long int phases[PERF_PHASES_NUM];                 // lines written for each phase
+} perf_counters;
+
+static const char * perfPhaseNames[PERF_PHASES_NUM] = { "parse", "execute", "teardown" };
+
+/****************************************************************
+ * Returns the current (scaled) value of a counter: when there are
+ * more counters than hardware registers, the kernel multiplexes
+ * them and the value is scaled to the whole time it was enabled
+ ****************************************************************/
+static unsigned long long perfRead(int fd) {
+	unsigned long long values[3];      // value, time enabled, time running
+
+	if (read(fd, values, sizeof(values)) != sizeof(values) || values[2] == 0)
+		return 0;
+	if (values[2] < values[1])
+		return (unsigned long long) ((double) values[0] * values[1] / values[2]);
+	return values[0];
+}
+
+/****************************************************************
+ * Opens the counters of the calling thread (and, with inherit, of
+ * the threads it creates afterwards) and writes the header of the
+ * lines in out. If no counter is available only the times are
+ * written, after a warning.
+ ****************************************************************/
+static void perfOpen(perf_counters * p, FILE * out, const char * engine, int inherit) {
+	memset(p, 0, sizeof(perf_counters));
+	p->out = out;
+	p->engine = engine;
+
+	int available = 0;
+	int error = ENOSYS;
+	for (int i = 0; i < PERF_COUNTERS_NUM; i++) {
+		p->fd[i] = -1;
+#ifdef __linux__
+		static const unsigned int types[PERF_COUNTERS_NUM] = {
+			PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE
+		};
+		static const unsigned long long configs[PERF_COUNTERS_NUM] = {
+			PERF_COUNT_HW_CPU_CYCLES,
+			PERF_COUNT_HW_INSTRUCTIONS,
+			PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+			PERF_COUNT_HW_CACHE_MISSES,
+			PERF_COUNT_HW_BRANCH_MISSES
+		};
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = types[i];
+		attr.config = configs[i];
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		attr.exclude_kernel = 1;     // allowed with perf_event_paranoid up to 2
+		attr.exclude_hv = 1;
+		attr.inherit = (inherit != 0) ? 1 : 0;
+		p->fd[i] = (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+		if (p->fd[i] == -1)
+			error = errno;
+		else available++;
+#endif
+	}
+
+	if (available == 0)
+		fprintf(stderr, "hardware counters not available (%s), only the times are reported\n", strerror(error));
+	fprintf(out, "engine\tstring\tphase\tns\tcycles\tinstructions\tL1d_misses\tLLC_misses\tbranch_misses\n");
+}
+
+/****************************************************************
+ * Starts a phase: the counters are read now and when it stops
+ ****************************************************************/
+static void perfStart(perf_counters * p) {
+	if (p->out == NULL)
+		return;
+	for (int i = 0; i < PERF_COUNTERS_NUM; i++)
+		p->start[i] = (p->fd[i] == -1) ? 0 : perfRead(p->fd[i]);
+	clock_gettime(CLOCK_MONOTONIC, &p->startTime);
+}
+
+/****************************************************************
+ * Stops a phase and writes its line: string is the number of the
+ * string it belongs to, 0 if it belongs to no single string
+ ****************************************************************/
+static void perfStop(perf_counters * p, long int string, int phase) {
+	if (p->out == NULL)
+		return;
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	unsigned long long ns = (now.tv_sec - p->startTime.tv_sec) * 1000000000ULL + now.tv_nsec - p->startTime.tv_nsec;
+
+	fprintf(p->out, "%s\t%ld\t%s\t%llu", p->engine, string, perfPhaseNames[phase], ns);
+	p->totals[phase][0] += ns;
+	for (int i = 0; i < PERF_COUNTERS_NUM; i++) {
+		if (p->fd[i] == -1) {
+			fprintf(p->out, "\t-");
+			continue;
+		}
+		unsigned long long value = perfRead(p->fd[i]);
+		value = (value > p->start[i]) ? value - p->start[i] : 0;
+		p->totals[phase][i+1] += value;
+		fprintf(p->out, "\t%llu", value);
+	}
+	fprintf(p->out, "\n");
+	p->phases[phase]++;
+}
+
+/****************************************************************
+ * Writes the totals of the phases (string "total") and closes the
+ * counters
+ ****************************************************************/
+static void perfClose(perf_counters * p) {
+	if (p->out == NULL)
+		return;
+	for (int phase = 0; phase < PERF_PHASES_NUM; phase++) {
+		if (p->phases[phase] == 0)
+			continue;
+		fprintf(p->out, "%s\ttotal\t%s\t%llu", p->engine, perfPhaseNames[phase], p->totals[phase][0]);
+		for (int i = 0; i < PERF_COUNTERS_NUM; i++) {
+			if (p->fd[i] == -1)
+				fprintf(p->out, "\t-");
+			else fprintf(p->out, "\t%llu", p->totals[phase][i+1]);
+		}
+		fprintf(p->out, "\n");
+	}
+	for (int i = 0; i < PERF_COUNTERS_NUM; i++) {
+		if (p->fd[i] != -1)
+			close(p->fd[i]);
+	}
+	fflush(p->out);
+	p->out = NULL;
+}
+
+#endif
@@ -0,0 +1,53 @@
+#!/bin/sh
+#
+# Builds the simulators and runs them on the inputs of the test
+# directories, comparing their results with the expected outputs.
+# A crash or a timeout counts as a failure (its exit status is shown).
+#
+#   test/run_tests.sh [engine ...]
+#
+# The engines are ndtm_iterative, ndtm_iterative_jit (the same, built
+# with -DJIT), ndtm_recursive and ndtm_STATIC_QUEUE_iterative (all of
+# them by default). Each engine also runs test/loop.txt, a machine
+# that never stops, with a time budget: it must give U for every
+# string well before the timeout. Set CC/CFLAGS to change the build,
+# TIMEOUT (seconds) to change the time given to each input and ARGS
+# to pass options to the simulators.
+
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:-"-O2"}
+TIMEOUT=${TIMEOUT:-120}
+ENGINES=${*:-"ndtm_iterative ndtm_iterative_jit ndtm_recursive ndtm_STATIC_QUEUE_iterative"}
+
+DIR=$(dirname "$0")
+BIN=$(mktemp -d /tmp/ndtm_test.XXXXXX)
+trap 'rm -rf "$BIN"' EXIT
+
+failures=0
+for engine in $ENGINES; do
+	sources="$DIR/../src/$engine.c"
+	flags=""
+	[ "$engine" = ndtm_STATIC_QUEUE_iterative ] && sources="$sources $DIR/../src/libndtm.c"
+	[ "$engine" = ndtm_iterative_jit ] && sources="$DIR/../src/ndtm_iterative.c" && flags="-DJIT"
+	$CC $CFLAGS $flags -o "$BIN/$engine" $sources -lpthread -ldl || exit 1
+
+	for input in "$DIR"/*/input.*; do
+		output=$(echo "$input" | sed 's,/input\.\([^/]*\)$,/output.\1,')
+		timeout "$TIMEOUT" "$BIN/$engine" $ARGS < "$input" > "$BIN/result" 2> /dev/null
+		status=$?
+		if [ $status -ne 0 ] || [ "$(tr -d '\r' < "$output")" != "$(cat "$BIN/result")" ]; then
+			echo "FAIL $engine $(basename "$(dirname "$input")")/$(basename "$input") (exit status $status)"
+			failures=$((failures + 1))
+		fi
+	done
+
+	result=$(timeout 20 "$BIN/$engine" $ARGS -t 200 < "$DIR/loop.txt" 2> /dev/null)
+	status=$?
+	if [ $status -ne 0 ] || [ "$result" != "$(printf 'U\nU')" ]; then
+		echo "FAIL $engine loop.txt with -t 200 (exit status $status)"
+		failures=$((failures + 1))
+	fi
+done
+
+echo "$failures failures"
+[ $failures -eq 0 ]